@@ -0,0 +1,150 @@
+#!/bin/bash
+#
+# bench.sh
+#
+# Misst die Shell von aussen (Aufruf: ./bench.sh [anzahl] [abschnitt]).
+# Die Shell muss vorher mit compile.sh gebaut sein (oder SHELL_BIN setzen).
+#
+#  startup : Zeit vom Start der Shell bis zum exec() des Programms (-c)
+#  seq     : anzahl mal /bin/true nacheinander aus einem Skript (Befehle/s)
+#  bg      : anzahl mal /bin/true & aus einem Skript (Befehle/s)
+#  pipe    : PIPE_MB MB durch Pipes mit 2..16 Stufen cat (MB/s)
+#  rss     : maximaler Speicher (VmHWM) der Shell nach seq und pipe
+#
+# seq, bg und pipe laufen einmal mit fork() (-f) und einmal mit
+# posix_spawn() (-p), damit die beiden Varianten verglichen werden koennen.
+# Alles laeuft offline, gebraucht werden nur bash, awk, head und cat.
+#
+
+cd "$(dirname "$0")/files" || exit 1
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+RUNS=${1:-1000}
+SECTION=${2:-all}
+PIPE_MB=${PIPE_MB:-1024}			# 1024..10240 fuer 1..10 GB
+STAGES=${STAGES:-"2 4 8 16"}
+MODES=${MODES:-"-f -p"}
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# fuehrt "$@" RUNS mal aus und gibt die mittlere Zeit in Mikrosekunden aus
+measure() {
+	local i start end
+	start=$EPOCHREALTIME
+	for ((i = 0; i < RUNS; i++)); do
+		"$@" >/dev/null
+	done
+	end=$EPOCHREALTIME
+	echo "$start $end $RUNS" | awk '{ printf "%8.1f", ($2 - $1) * 1e6 / $3 }'
+}
+
+# eine Zeile Ergebnis: name, Zeit pro Lauf und Differenz zur Basis
+report() {
+	printf "%-32s %s us/run" "$1" "$2"
+	if [ -n "$3" ]; then
+		echo "$2 $3" | awk '{ printf "  (+%.1f us)", $1 - $2 }'
+	fi
+	echo
+}
+
+# fuehrt "$@" einmal aus und gibt die Dauer in Sekunden aus
+once() {
+	local start end
+	start=$EPOCHREALTIME
+	"$@" >/dev/null
+	end=$EPOCHREALTIME
+	echo "$start $end" | awk '{ printf "%.6f", $2 - $1 }'
+}
+
+# eine Zeile Durchsatz: name, Menge, Einheit, Dauer in Sekunden
+rate() {
+	echo "$2 $4" | awk -v n="$1" -v u="$3" \
+		'{ printf "%-32s %10.1f %s  (%.3f s)\n", n, $1 / $2, u, $2 }'
+}
+
+# Skript mit RUNS mal der Zeile "$1"
+script() {
+	local i
+	for ((i = 0; i < RUNS; i++)); do
+		echo "$1"
+	done >"$2"
+}
+
+startup() {
+	echo "== startup ($RUNS runs)"
+	local base
+	base=$(measure /bin/true)
+	report "/bin/true (direkt)" "$base"
+	report "shell -c /bin/true" "$(measure $SHELL_BIN -c /bin/true)" "$base"
+	report "shell -c 'cd /; /bin/true'" "$(measure $SHELL_BIN -c 'cd /; /bin/true')" "$base"
+	report "shell -c 'sleep 0' (PATH)" "$(measure $SHELL_BIN -c 'sleep 0')" "$base"
+	report "shell -c 'true' (Builtin)" "$(measure $SHELL_BIN -c true)" "$base"
+	for other in dash bash; do
+		command -v $other >/dev/null &&
+			report "$other -c /bin/true" "$(measure $other -c /bin/true)" "$base"
+	done
+}
+
+sequential() {
+	echo "== seq ($RUNS Befehle)"
+	script /bin/true "$TMP/seq.sh"
+	for mode in $MODES; do
+		rate "shell $mode: /bin/true" $RUNS "Befehle/s" \
+			"$(once $SHELL_BIN $mode "$TMP/seq.sh")"
+	done
+	command -v dash >/dev/null &&
+		rate "dash: /bin/true" $RUNS "Befehle/s" "$(once dash "$TMP/seq.sh")"
+}
+
+background() {
+	echo "== bg ($RUNS Befehle)"
+	script "/bin/true &" "$TMP/bg.sh"
+	for mode in $MODES; do
+		rate "shell $mode: /bin/true &" $RUNS "Befehle/s" \
+			"$(once $SHELL_BIN $mode "$TMP/bg.sh")"
+	done
+}
+
+# head -c liefert PIPE_MB MB, n-1 mal cat reicht sie weiter
+pipeline() {
+	local n=$1 i line="head -c ${PIPE_MB}M /dev/zero"
+	for ((i = 1; i < n; i++)); do
+		line="$line | cat"
+	done
+	echo "$line >/dev/null"
+}
+
+pipes() {
+	echo "== pipe ($PIPE_MB MB)"
+	for n in $STAGES; do
+		pipeline $n >"$TMP/pipe.sh"
+		for mode in $MODES; do
+			rate "shell $mode: $n Stufen" $PIPE_MB "MB/s" \
+				"$(once $SHELL_BIN $mode "$TMP/pipe.sh")"
+		done
+	done
+}
+
+# /bin/sh ist ein Kind der Shell und liest deren Speicherverbrauch
+memory() {
+	echo "== rss"
+	local probe="/bin/sh -c 'grep VmHWM /proc/\$PPID/status'"
+	echo "$probe" >"$TMP/rss.sh"
+	printf "%-32s %s\n" "shell: leer" "$($SHELL_BIN "$TMP/rss.sh")"
+	script /bin/true "$TMP/rss.sh"
+	echo "$probe" >>"$TMP/rss.sh"
+	printf "%-32s %s\n" "shell: nach seq" "$($SHELL_BIN "$TMP/rss.sh")"
+	pipeline 16 >"$TMP/rss.sh"
+	echo "$probe" >>"$TMP/rss.sh"
+	printf "%-32s %s\n" "shell: nach pipe" "$($SHELL_BIN "$TMP/rss.sh")"
+}
+
+[ -x $SHELL_BIN ] || { echo "$SHELL_BIN fehlt, erst compile.sh ausfuehren"; exit 1; }
+
+case $SECTION in
+	startup|all) startup ;;&
+	seq|all) sequential ;;&
+	bg|all) background ;;&
+	pipe|all) pipes ;;&
+	rss|all) memory ;;
+esac
@@ -1,7 +1,7 @@
 #!/system/bin/bash
 
 cd files/
-gcc -o shell Shell.c Parser.c Execute.c Tools.c -lreadline       
+gcc -o shell Shell.c Parser.c Execute.c Tools.c Script.c Jobs.c Parallel.c Stats.c Builtins.c Vars.c -lreadline -pthread       
 ./shell
 
 
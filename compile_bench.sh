@@ -0,0 +1,7 @@
+#!/system/bin/bash
+
+# Parser-Benchmark bauen und ausfuehren (CSV auf stdout),
+# Aufruf: ./compile_bench.sh [sekunden] [workload] > ergebnis.csv
+cd files/
+gcc -O2 -o parserbench ParserBench.c Parser.c
+./parserbench "$@"
@@ -0,0 +1,803 @@
+/*
+ * Builtins.c
+ *
+ *  Programme, die so oft aufgerufen werden, dass sich whereIs(), fork()
+ *  und exec() nicht lohnen, laufen direkt in der Shell:
+ *  - true, false
+ *  - echo [-neE] args		(wie coreutils, ohne --help/--version)
+ *  - printf format args	(wie coreutils, ohne %q)
+ *  - test ausdruck, [ ausdruck ]
+ *  Die Umleitungen (<, >) werden per dup()/dup2() gesetzt und danach
+ *  wieder zurueckgenommen. Mit time werden weiter die Programme aus dem
+ *  PATH gestartet.
+ *
+ *  In einer Pipe laeuft ein Builtin in einem eigenen Thread der Shell und
+ *  schreibt in die Pipe zum naechsten Programm (startStage). Keins der
+ *  Builtins liest stdin, zwei benachbarte Builtins brauchen also keinen
+ *  Kanal: das Leseende schliesst die Shell sofort.
+ */
+
+#define _GNU_SOURCE		// AT_EACCESS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "Parser.h"
+#include "Builtins.h"
+
+#define SAVE_FD 10		// gesicherte fds liegen ab hier
+
+/* Escape-Sequenzen --------------------------------------------------- */
+
+enum escape_mode {
+	ESC_ECHO,		// echo -e und printf %b: \0nnn, \nnn, kein \"
+	ESC_FORMAT		// printf Format: \nnn, \"
+};
+
+static int hexValue(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * Gibt die Escape-Sequenz aus, *s zeigt auf das Zeichen nach '\' und
+ * wird hinter die Sequenz gesetzt.
+ * Rueckgabe: 0 weiter, 1 bei \c (keine weitere Ausgabe), -1 bei Fehler
+ */
+static int putEscape(char** s, enum escape_mode mode, FILE* out) {
+	char* p = *s;
+	int c, digits;
+
+	switch (*p) {
+	case '\\': c = '\\'; break;
+	case 'a': c = '\a'; break;
+	case 'b': c = '\b'; break;
+	case 'c': *s = p + 1; return 1;
+	case 'e': c = 27; break;
+	case 'f': c = '\f'; break;
+	case 'n': c = '\n'; break;
+	case 'r': c = '\r'; break;
+	case 't': c = '\t'; break;
+	case 'v': c = '\v'; break;
+	case 'x':
+		if (hexValue(p[1]) < 0) {
+			if (mode == ESC_FORMAT) {
+				fprintf(stderr, "printf: Hexzahl nach \\x fehlt\n");
+				return -1;
+			}
+			fputc('\\', out);		// echo gibt \x unveraendert aus
+			*s = p;
+			return 0;
+		}
+		c = hexValue(*++p);
+		if (hexValue(p[1]) >= 0)
+			c = c * 16 + hexValue(*++p);
+		break;
+	case '"':
+		if (mode == ESC_FORMAT) {
+			c = '"';
+			break;
+		}
+		/* no break */
+	default:
+		if (*p >= '0' && *p <= '7') {
+			// bei echo darf nach \0 noch eine dreistellige Oktalzahl folgen
+			if (*p == '0' && mode == ESC_ECHO)
+				p++;
+			for (c = 0, digits = 0; digits < 3 && *p >= '0' && *p <= '7';
+					digits++)
+				c = c * 8 + *p++ - '0';
+			*s = p;
+			fputc(c, out);
+			return 0;
+		}
+		fputc('\\', out);			// unbekannt: Backslash bleibt stehen
+		*s = p;
+		return 0;
+	}
+	fputc(c, out);
+	*s = p + 1;
+	return 0;
+}
+
+/* true, false, echo -------------------------------------------------- */
+
+static int builtinTrue(int argc, char** argv, FILE* out) {
+	return 0;
+}
+
+static int builtinFalse(int argc, char** argv, FILE* out) {
+	return 1;
+}
+
+/*
+ * Optionen nur am Anfang und nur aus n, e, E (z.B. -ne), alles andere
+ * wird ausgegeben
+ */
+static int builtinEcho(int argc, char** argv, FILE* out) {
+	int newline = 1, escapes = 0, i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+		char* o = argv[i] + 1;
+		if (o[strspn(o, "neE")] != '\0')
+			break;
+		for (; *o; o++) {
+			if (*o == 'n')
+				newline = 0;
+			else
+				escapes = *o == 'e';
+		}
+	}
+	for (; i < argc; i++) {
+		char* p = argv[i];
+		if (!escapes)
+			fputs(p, out);
+		else
+			while (*p) {
+				if (*p != '\\' || p[1] == '\0') {
+					fputc(*p++, out);
+					continue;
+				}
+				p++;
+				if (putEscape(&p, ESC_ECHO, out) > 0)
+					return 0;			// \c: keine weitere Ausgabe
+			}
+		if (i + 1 < argc)
+			fputc(' ', out);
+	}
+	if (newline)
+		fputc('\n', out);
+	return 0;
+}
+
+/* printf ------------------------------------------------------------- */
+
+/*
+ * Zahl fuer %d usw.: 'x bzw. "x ergibt den Zeichencode, sonst wie
+ * strtoimax() (Basis 8, 10 oder 16). Reste sind ein Fehler.
+ */
+static intmax_t intArg(char* arg, int* status) {
+	char* end;
+
+	if (arg[0] == '\'' || arg[0] == '"')
+		return (unsigned char) arg[1];
+	errno = 0;
+	intmax_t value = strtoimax(arg, &end, 0);
+	if (end == arg && *arg != '\0') {
+		fprintf(stderr, "printf: '%s': Zahl erwartet\n", arg);
+		*status = 1;
+	} else if (*end != '\0') {
+		fprintf(stderr, "printf: '%s': nicht vollstaendig umgewandelt\n", arg);
+		*status = 1;
+	} else if (errno == ERANGE) {
+		fprintf(stderr, "printf: '%s': %s\n", arg, strerror(errno));
+		*status = 1;
+	}
+	return value;
+}
+
+static uintmax_t uintArg(char* arg, int* status) {
+	char* end;
+
+	if (arg[0] == '\'' || arg[0] == '"')
+		return (unsigned char) arg[1];
+	errno = 0;
+	uintmax_t value = strtoumax(arg, &end, 0);
+	if ((end == arg && *arg != '\0') || *end != '\0' || errno == ERANGE) {
+		fprintf(stderr, "printf: '%s': ungueltige Zahl\n", arg);
+		*status = 1;
+	}
+	return value;
+}
+
+static long double floatArg(char* arg, int* status) {
+	char* end;
+
+	if (arg[0] == '\'' || arg[0] == '"')
+		return (unsigned char) arg[1];
+	long double value = strtold(arg, &end);
+	if ((end == arg && *arg != '\0') || *end != '\0') {
+		fprintf(stderr, "printf: '%s': ungueltige Zahl\n", arg);
+		*status = 1;
+	}
+	return value;
+}
+
+/*
+ * Gibt das Format einmal aus, *args und *nargs werden um die verbrauchten
+ * Argumente weitergesetzt, fehlende gelten als "" bzw. 0.
+ * Rueckgabe: 0 weiter, 1 bei \c, -1 bei Fehler
+ */
+static int printFormat(char* format, char*** args, int* nargs, int* status,
+		FILE* out) {
+	char spec[64];
+	char* p = format;
+
+	while (*p) {
+		if (*p == '\\' && p[1] != '\0') {
+			p++;
+			int stop = putEscape(&p, ESC_FORMAT, out);
+			if (stop)
+				return stop;
+			continue;
+		}
+		if (*p != '%') {
+			fputc(*p++, out);
+			continue;
+		}
+		if (p[1] == '%') {
+			fputc('%', out);
+			p += 2;
+			continue;
+		}
+
+		// %[flags][breite][.genauigkeit]umwandlung nach spec kopieren
+		char* start = p++;
+		size_t len = 1;
+		spec[0] = '%';
+		while (*p && strchr("-+ #0", *p) && len < 20)
+			spec[len++] = *p++;
+		if (*p == '*') {
+			char* arg = *nargs > 0 ? ((*nargs)--, *(*args)++) : "";
+			len += snprintf(spec + len, 16, "%d", (int) intArg(arg, status));
+			p++;
+		} else
+			while (*p >= '0' && *p <= '9' && len < 40)
+				spec[len++] = *p++;
+		if (*p == '.') {
+			spec[len++] = *p++;
+			if (*p == '*') {
+				char* arg = *nargs > 0 ? ((*nargs)--, *(*args)++) : "";
+				len += snprintf(spec + len, 16, "%d",
+						(int) intArg(arg, status));
+				p++;
+			} else
+				while (*p >= '0' && *p <= '9' && len < 56)
+					spec[len++] = *p++;
+		}
+		while (*p && strchr("hlLqjzt", *p))		// Laengen werden ignoriert
+			p++;
+
+		char conv = *p;
+		if (conv == '\0' || !strchr("diouxXeEfFgGaAcsb", conv)) {
+			fprintf(stderr, "printf: %.*s: ungueltige Formatangabe\n",
+					(int) (p - start + (conv != '\0')), start);
+			*status = 1;
+			return -1;
+		}
+		p++;
+		char* arg = *nargs > 0 ? ((*nargs)--, *(*args)++) : NULL;
+
+		switch (conv) {
+		case 'd':
+		case 'i':
+			strcpy(spec + len, "jd");
+			fprintf(out, spec, arg ? intArg(arg, status) : (intmax_t) 0);
+			break;
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			spec[len++] = 'j';
+			spec[len++] = conv;
+			spec[len] = '\0';
+			fprintf(out, spec, arg ? uintArg(arg, status) : (uintmax_t) 0);
+			break;
+		case 'c':
+			strcpy(spec + len, "c");
+			fprintf(out, spec, arg ? arg[0] : '\0');
+			break;
+		case 's':
+			strcpy(spec + len, "s");
+			fprintf(out, spec, arg ? arg : "");
+			break;
+		case 'b': {
+			// Escapes im Argument aufloesen, dann wie %s ausgeben
+			char* text = NULL;
+			size_t size = 0;
+			int stop = 0;
+			FILE* mem = open_memstream(&text, &size);
+			if (mem == NULL) {
+				perror("printf");
+				return -1;
+			}
+			for (char* a = arg ? arg : ""; *a && !stop;) {
+				if (*a != '\\' || a[1] == '\0') {
+					fputc(*a++, mem);
+					continue;
+				}
+				a++;
+				stop = putEscape(&a, ESC_ECHO, mem);
+			}
+			fclose(mem);
+			strcpy(spec + len, "s");
+			fprintf(out, spec, text);
+			free(text);
+			if (stop)
+				return 1;
+			break;
+		}
+		default:						// Gleitkomma
+			spec[len++] = 'L';
+			spec[len++] = conv;
+			spec[len] = '\0';
+			fprintf(out, spec, arg ? floatArg(arg, status) : 0.0L);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Das Format wird wiederholt, solange es Argumente verbraucht und noch
+ * welche uebrig sind
+ */
+static int builtinPrintf(int argc, char** argv, FILE* out) {
+	int status = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "printf: Operand fehlt\n");
+		return 1;
+	}
+	char** args = argv + 2;
+	int nargs = argc - 2;
+	for (;;) {
+		int before = nargs;
+		int stop = printFormat(argv[1], &args, &nargs, &status, out);
+		if (stop < 0)
+			status = 1;
+		if (stop)
+			break;
+		if (nargs == 0 || nargs == before)
+			break;
+	}
+	return status;
+}
+
+/* test und [ --------------------------------------------------------- */
+
+typedef struct test_ctx {
+	int argc;
+	char** argv;
+	int pos;				// naechstes Argument
+	int error;				// Syntaxfehler gemeldet
+} test_ctx;
+
+static int testError(test_ctx* t, const char* text, const char* arg) {
+	if (!t->error) {
+		if (arg != NULL)
+			fprintf(stderr, "test: '%s': %s\n", arg, text);
+		else
+			fprintf(stderr, "test: %s\n", text);
+	}
+	t->error = 1;
+	return 0;
+}
+
+/*
+ * Ganze Zahl mit optionalen Leerzeichen davor und danach
+ */
+static intmax_t testInt(test_ctx* t, char* arg) {
+	char* end;
+
+	errno = 0;
+	intmax_t value = strtoimax(arg, &end, 10);
+	while (*end == ' ' || *end == '\t')
+		end++;
+	if (end == arg || *end != '\0' || errno == ERANGE) {
+		testError(t, "ungueltige Zahl", arg);
+		return 0;
+	}
+	return value;
+}
+
+static int isUnary(char* op) {
+	return op[0] == '-' && op[1] != '\0' && op[2] == '\0'
+			&& strchr("bcdefgGhkLnNOprsStuwxz", op[1]) != NULL;
+}
+
+static int isBinary(char* op) {
+	static const char* ops[] = { "=", "==", "!=", "-eq", "-ne",
+			"-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", "-a", "-o", NULL };
+	int i;
+
+	for (i = 0; ops[i] != NULL; i++)
+		if (!strcmp(op, ops[i]))
+			return 1;
+	return 0;
+}
+
+static int unary(test_ctx* t, char op, char* arg) {
+	struct stat st;
+
+	switch (op) {
+	case 'n':
+		return arg[0] != '\0';
+	case 'z':
+		return arg[0] == '\0';
+	case 't': {
+		intmax_t fd = testInt(t, arg);
+		return !t->error && fd >= 0 && fd <= 1024 && isatty(fd);
+	}
+	case 'r':
+		return faccessat(AT_FDCWD, arg, R_OK, AT_EACCESS) == 0;
+	case 'w':
+		return faccessat(AT_FDCWD, arg, W_OK, AT_EACCESS) == 0;
+	case 'x':
+		return faccessat(AT_FDCWD, arg, X_OK, AT_EACCESS) == 0;
+	case 'h':
+	case 'L':
+		return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+	}
+	if (stat(arg, &st) != 0)
+		return 0;
+	switch (op) {
+	case 'e': return 1;
+	case 'f': return S_ISREG(st.st_mode);
+	case 'd': return S_ISDIR(st.st_mode);
+	case 'b': return S_ISBLK(st.st_mode);
+	case 'c': return S_ISCHR(st.st_mode);
+	case 'p': return S_ISFIFO(st.st_mode);
+	case 'S': return S_ISSOCK(st.st_mode);
+	case 's': return st.st_size > 0;
+	case 'g': return (st.st_mode & S_ISGID) != 0;
+	case 'u': return (st.st_mode & S_ISUID) != 0;
+	case 'k': return (st.st_mode & S_ISVTX) != 0;
+	case 'O': return st.st_uid == geteuid();
+	case 'G': return st.st_gid == getegid();
+	case 'N':
+		return st.st_mtim.tv_sec > st.st_atim.tv_sec
+				|| (st.st_mtim.tv_sec == st.st_atim.tv_sec
+						&& st.st_mtim.tv_nsec > st.st_atim.tv_nsec);
+	}
+	return 0;
+}
+
+/*
+ * -1, 0, 1 je nachdem ob a aelter, gleich alt oder neuer ist als b;
+ * eine fehlende Datei ist aelter als jede vorhandene
+ */
+static int compareTimes(char* a, char* b) {
+	struct stat sa, sb;
+	int ha = stat(a, &sa) == 0, hb = stat(b, &sb) == 0;
+
+	if (!ha || !hb)
+		return ha - hb;
+	if (sa.st_mtim.tv_sec != sb.st_mtim.tv_sec)
+		return sa.st_mtim.tv_sec < sb.st_mtim.tv_sec ? -1 : 1;
+	if (sa.st_mtim.tv_nsec != sb.st_mtim.tv_nsec)
+		return sa.st_mtim.tv_nsec < sb.st_mtim.tv_nsec ? -1 : 1;
+	return 0;
+}
+
+static int binary(test_ctx* t, char* a, char* op, char* b) {
+	struct stat sa, sb;
+
+	if (!strcmp(op, "=") || !strcmp(op, "=="))
+		return strcmp(a, b) == 0;
+	if (!strcmp(op, "!="))
+		return strcmp(a, b) != 0;
+	if (!strcmp(op, "-a"))
+		return a[0] != '\0' && b[0] != '\0';
+	if (!strcmp(op, "-o"))
+		return a[0] != '\0' || b[0] != '\0';
+	if (!strcmp(op, "-nt"))
+		return compareTimes(a, b) > 0;
+	if (!strcmp(op, "-ot"))
+		return compareTimes(a, b) < 0;
+	if (!strcmp(op, "-ef"))
+		return stat(a, &sa) == 0 && stat(b, &sb) == 0
+				&& sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+
+	// -eq, -ne, -lt, -le, -gt, -ge
+	intmax_t x = testInt(t, a), y = testInt(t, b);
+	if (!strcmp(op, "-eq"))
+		return x == y;
+	if (!strcmp(op, "-ne"))
+		return x != y;
+	if (!strcmp(op, "-lt"))
+		return x < y;
+	if (!strcmp(op, "-le"))
+		return x <= y;
+	if (!strcmp(op, "-gt"))
+		return x > y;
+	return x >= y;
+}
+
+static int testOr(test_ctx* t);
+
+/*
+ * primary := '(' or ')' | arg binop arg | unop arg | '!' primary | arg
+ */
+static int testPrimary(test_ctx* t) {
+	char** v = t->argv;
+	int left = t->argc - t->pos;
+
+	if (left <= 0)
+		return testError(t, "Argument erwartet", NULL);
+	if (!strcmp(v[t->pos], "!")) {
+		t->pos++;
+		return !testPrimary(t);
+	}
+	if (!strcmp(v[t->pos], "(") && !(left >= 3 && isBinary(v[t->pos + 1]))) {
+		t->pos++;
+		int result = testOr(t);
+		if (t->pos >= t->argc || strcmp(v[t->pos], ")"))
+			return testError(t, "')' erwartet", NULL);
+		t->pos++;
+		return result;
+	}
+	if (left >= 3 && isBinary(v[t->pos + 1])
+			&& strcmp(v[t->pos + 1], "-a") && strcmp(v[t->pos + 1], "-o")) {
+		t->pos += 3;
+		return binary(t, v[t->pos - 3], v[t->pos - 2], v[t->pos - 1]);
+	}
+	if (isUnary(v[t->pos])) {
+		if (left < 2)
+			return testError(t, "Argument erwartet", v[t->pos]);
+		t->pos += 2;
+		return unary(t, v[t->pos - 2][1], v[t->pos - 1]);
+	}
+	return v[t->pos++][0] != '\0';
+}
+
+static int testAnd(test_ctx* t) {
+	int result = testPrimary(t);
+	while (t->pos < t->argc && !strcmp(t->argv[t->pos], "-a")) {
+		t->pos++;
+		result = testPrimary(t) && result;
+	}
+	return result;
+}
+
+static int testOr(test_ctx* t) {
+	int result = testAnd(t);
+	while (t->pos < t->argc && !strcmp(t->argv[t->pos], "-o")) {
+		t->pos++;
+		result = testAnd(t) || result;
+	}
+	return result;
+}
+
+/*
+ * Bis zu vier Argumente nach den festen Regeln von POSIX, erst danach
+ * wird der Ausdruck geparst (so ist z.B. "test -n" oder "test ! =" gueltig)
+ */
+static int testArgs(test_ctx* t, int n) {
+	char** v = t->argv + t->pos;
+
+	switch (n) {
+	case 0:
+		return 0;
+	case 1:
+		t->pos++;
+		return v[0][0] != '\0';
+	case 2:
+		if (!strcmp(v[0], "!")) {
+			t->pos++;
+			return !testArgs(t, 1);
+		}
+		if (isUnary(v[0])) {
+			t->pos += 2;
+			return unary(t, v[0][1], v[1]);
+		}
+		return testError(t, "einstelliger Operator erwartet", v[0]);
+	case 3:
+		if (isBinary(v[1])) {
+			t->pos += 3;
+			return binary(t, v[0], v[1], v[2]);
+		}
+		if (!strcmp(v[0], "!")) {
+			t->pos++;
+			return !testArgs(t, 2);
+		}
+		if (!strcmp(v[0], "(") && !strcmp(v[2], ")")) {
+			t->pos += 3;
+			return v[1][0] != '\0';
+		}
+		return testError(t, "zweistelliger Operator erwartet", v[1]);
+	case 4:
+		if (!strcmp(v[0], "!")) {
+			t->pos++;
+			return !testArgs(t, 3);
+		}
+		if (!strcmp(v[0], "(") && !strcmp(v[3], ")")) {
+			t->pos++;
+			int result = testArgs(t, 2);
+			t->pos++;
+			return result;
+		}
+	}
+	return testOr(t);
+}
+
+/*
+ * 0 wahr, 1 falsch, 2 Fehler
+ */
+static int builtinTest(int argc, char** argv, FILE* out) {
+	test_ctx t = { argc, argv, 1, 0 };
+
+	if (!strcmp(argv[0], "[")) {
+		if (strcmp(argv[argc - 1], "]")) {
+			fprintf(stderr, "[: ']' fehlt\n");
+			return 2;
+		}
+		t.argc--;
+	}
+	int result = testArgs(&t, t.argc - 1);
+	if (!t.error && t.pos < t.argc)
+		testError(&t, "zusaetzliches Argument", t.argv[t.pos]);
+	return t.error ? 2 : !result;
+}
+
+/* Registry ----------------------------------------------------------- */
+
+/*
+ * Die Namen kennt der Parser (builtin_table in Parser.c), hier steht nur
+ * die Funktion zu jedem enum prog_builtin
+ */
+static const builtin_fn builtins[] = {
+	[EXTERNAL] = NULL,
+	[BUILTIN_ECHO] = builtinEcho,
+	[BUILTIN_PRINTF] = builtinPrintf,
+	[BUILTIN_TEST] = builtinTest,
+	[BUILTIN_TRUE] = builtinTrue,
+	[BUILTIN_FALSE] = builtinFalse
+};
+
+builtin_fn getBuiltin(prog_args* prog) {
+	return builtins[prog->builtin];
+}
+
+/*
+ * Sichert fd und legt die Datei darauf. Gibt den gesicherten fd zurueck
+ * (-1 wenn nichts umgeleitet wurde), -2 bei Fehlern.
+ */
+static int redirectSaved(char* file, int flags, int fd) {
+	if (file == NULL)
+		return -1;
+	int target = open(file, flags | O_CLOEXEC, 0666);
+	if (target < 0) {
+		perror(file);
+		return -2;
+	}
+	int saved = fcntl(fd, F_DUPFD_CLOEXEC, SAVE_FD);
+	dup2(target, fd);
+	close(target);
+	return saved;
+}
+
+static void restore(int saved, int fd) {
+	if (saved < 0)
+		return;
+	dup2(saved, fd);
+	close(saved);
+}
+
+int runBuiltin(prog_args* prog) {
+	builtin_fn fn = getBuiltin(prog);
+	int status = 1;
+
+	fflush(stdout);						// Gepuffertes gehoert nicht in die Datei
+	int in = redirectSaved(prog->input, O_RDONLY, STDIN_FILENO);
+	int out = in == -2 ? -2
+			: redirectSaved(prog->output, O_WRONLY | O_CREAT | O_TRUNC,
+					STDOUT_FILENO);
+	if (in != -2 && out != -2)
+		status = fn(prog->argc, prog->argv, stdout);
+	fflush(stdout);
+	restore(out, STDOUT_FILENO);
+	restore(in, STDIN_FILENO);
+	return status;
+}
+
+/* Builtins in Pipes -------------------------------------------------- */
+
+/*
+ * Alles, was der Thread braucht, in einem Block: argv wird kopiert, damit
+ * der Thread die Befehlsliste ueberleben darf (Hintergrund, Strg+Z)
+ */
+typedef struct stage {
+	builtin_fn fn;
+	int fd;					// Ausgabe (gehoert dem Thread)
+	int argc;
+	char* argv[];			// danach die Zeichenketten
+} stage;
+
+static void* runStage(void* arg) {
+	stage* s = arg;
+	int status = 1;
+
+	FILE* out = fdopen(s->fd, "w");
+	if (out != NULL) {
+		status = s->fn(s->argc, s->argv, out);
+		fclose(out);				// EOF fuer das naechste Programm
+	} else
+		close(s->fd);
+	free(s);
+	return (void*) (intptr_t) status;
+}
+
+/*
+ * Kopiert prog in einen stage-Block mit der Ausgabe fd
+ */
+static stage* newStage(prog_args* prog, int fd) {
+	size_t size = sizeof(stage) + (prog->argc + 1) * sizeof(char*);
+	int i;
+
+	for (i = 0; i < prog->argc; i++)
+		size += strlen(prog->argv[i]) + 1;
+	stage* s = malloc(size);
+	if (s == NULL)
+		return NULL;
+	s->fn = getBuiltin(prog);
+	s->fd = fd;
+	s->argc = prog->argc;
+	char* text = (char*) (s->argv + prog->argc + 1);
+	for (i = 0; i < prog->argc; i++) {
+		s->argv[i] = strcpy(text, prog->argv[i]);
+		text += strlen(text) + 1;
+	}
+	s->argv[i] = NULL;
+	return s;
+}
+
+int startStage(prog_args* prog, int outfd, pthread_t* thread) {
+	sigset_t all, old;
+	int fd = outfd;
+
+	if (prog->input != NULL) {			// Datei muss lesbar sein, wie beim Programm
+		int in = open(prog->input, O_RDONLY | O_CLOEXEC);
+		if (in < 0) {
+			perror(prog->input);
+			if (outfd >= 0)
+				close(outfd);
+			return -1;
+		}
+		close(in);
+	}
+	if (prog->output != NULL) {
+		if (outfd >= 0)
+			close(outfd);
+		fd = open(prog->output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	} else if (outfd < 0)
+		fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		perror(prog->output ? prog->output : "dup");
+		return -1;
+	}
+
+	stage* s = newStage(prog, fd);
+	if (s == NULL) {
+		perror(prog->argv[0]);
+		close(fd);
+		return -1;
+	}
+	/*
+	 * Der Thread bekommt keine Signale: SIGPIPE beendet dann nicht die
+	 * Shell, sondern write() liefert EPIPE
+	 */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int error = pthread_create(thread, NULL, runStage, s);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (error) {
+		fprintf(stderr, "%s: %s\n", prog->argv[0], strerror(error));
+		free(s);
+		close(fd);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Builtins.h
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+ * Ein Builtin bekommt argc/argv wie main() und die Ausgabe out und gibt
+ * den Exitstatus zurueck
+ */
+typedef int (*builtin_fn)(int argc, char** argv, FILE* out);
+
+/*
+ * Gibt die Funktion zum Builtin des Programms (prog->builtin, vom Parser
+ * gesetzt) zurueck, NULL fuer externe Programme
+ */
+builtin_fn getBuiltin(prog_args* prog);
+
+/*
+ * Fuehrt das Builtin in der Shell aus, Umleitungen von stdin/stdout
+ * gelten nur waehrend des Aufrufs. Gibt den Exitstatus zurueck.
+ */
+int runBuiltin(prog_args* prog);
+
+/*
+ * Startet das Builtin als Stufe einer Pipe in einem Thread, der nach outfd
+ * schreibt (-1 = stdout der Shell). outfd gehoert danach dem Builtin und
+ * wird in jedem Fall geschlossen. Das Ergebnis von pthread_join() ist der
+ * Exitstatus.
+ * Rueckgabe: 0 wenn der Thread laeuft, -1 bei Fehlern
+ */
+int startStage(prog_args* prog, int outfd, pthread_t* thread);
@@ -7,171 +7,656 @@
  *  Modul um gegebene Befehlsliste ab zu arbeiten
  *  - exit 	: 	Shell beenden
  *  - cd 	:	cwd aendern
- *  - env	:	Variablen anlegen, loeschen
- *  - job	:	Jobmngt
+ *  - env	:	Variablen anlegen, exportieren, loeschen (siehe Vars.c)
+ *  - job	:	Jobmngt (siehe Jobs.c)
+ *  - source	:	Skript in dieser Shell ausfuehren
+ *  - parallel	:	Befehl fuer viele items gleichzeitig (siehe Parallel.c)
+ *  - time	:	Programm/Pipe messen (rusage per wait4, siehe Jobs.c)
+ *  - stats	:	Latenzen der Shell messen und anzeigen (siehe Stats.c)
+ *  - echo, printf, test, true, false : in der Shell (siehe Builtins.c)
  *  - prog	:	Programm ausfuehren (fg,bg)
  *
  */
 
+#define _GNU_SOURCE		// environ, POSIX_SPAWN_USEVFORK
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <signal.h>
-#include <string.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <time.h>
 
 #include "Parser.h"
 #include "Tools.h"
 #include "Execute.h"
+#include "Script.h"
+#include "Jobs.h"
+#include "Stats.h"
+#include "Builtins.h"
+#include "Vars.h"
+
+pid_t shell_pgid, pid, pgid;
 
 /*
- * Hilfsfunktion zum Ausfuehren eines externen Programms
- * Informationen dazu in der Doku
+ * Wie werden Programme gestartet?
+ * Voreinstellung beim Uebersetzen mit -DUSE_FORK aenderbar,
+ * zur Laufzeit mit den Shellargumenten -f (fork) und -p (posix_spawn).
  */
-int executeProg(prog_args* prog) {
+#if defined(_POSIX_SPAWN) && !defined(USE_FORK)
+int spawnMode = SPAWN_POSIX;
+#else
+int spawnMode = SPAWN_FORK;
+#endif
 
-	char* path = whereIs(prog->argv[0]);		// Programm suchen
-	if (!path) {
-		perror("Programm nicht gefunden");
-		return -1;
+/*
+ * Im -c Modus wird das letzte Programm der Befehlsliste nicht als Kind
+ * gestartet, sondern ersetzt die Shell (spart fork() und waitpid())
+ */
+int execLast;
+
+/*
+ * Exitstatus des letzten Befehls (wie $? in sh), bei -c und Skripten
+ * auch der Exitstatus der Shell
+ */
+int lastStatus;
+
+/*
+ * Wird gesetzt, wenn cd das Arbeitsverzeichnis geaendert hat
+ * (die Shell baut dann ihr Prompt neu)
+ */
+int cwdChanged = 1;
+
+/*
+ * Leitet fd auf target um (dup2) und schliesst fd
+ */
+static void redirect(int fd, int target) {
+	if (fd < 0 || fd == target)
+		return;
+	dup2(fd, target);
+	close(fd);
+}
+
+#ifdef _POSIX_SPAWN
+/*
+ * Startet ein Programm mit posix_spawn() statt fork()+exec().
+ * glibc nutzt dafuer clone(CLONE_VM|CLONE_VFORK): die Seitentabellen der
+ * Shell werden nicht kopiert, egal wie gross ihr Heap ist.
+ * Pipeenden werden als file actions beschrieben, Umleitungsdateien oeffnet
+ * die Shell selbst (O_CLOEXEC) und gibt sie per dup2 weiter. Laesst sich
+ * eine Datei nicht oeffnen, wird -2 zurueckgegeben: der Aufrufer startet
+ * die Stufe dann mit fork(), damit Fehlermeldung und Status genau wie
+ * mit -f sind (nur diese Stufe scheitert, die Pipe laeuft weiter).
+ * posix_spawn() kennt keinen Ordner-fd wie execveat() in execAt(): der
+ * Kernel loest hier den vollen Pfad aus whereIs() noch einmal auf.
+ * (addfchdir_np() + relativer Name ginge, wuerde aber das cwd des
+ * Programms aendern.)
+ */
+static pid_t spawnProg(prog_args* prog, char* path, int infd, int outfd,
+		int closefd, pid_t group) {
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t mask;
+	int error;
+	sigset_t defaults;
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+	int inFile = -1, outFile = -1;
+
+#ifdef POSIX_SPAWN_USEVFORK
+	flags |= POSIX_SPAWN_USEVFORK;
+#endif
+
+	if (prog->input != NULL) {			// redirect von Stdin auf file
+		if (debug)
+			printf("Input von %s\n", prog->input);
+		inFile = open(prog->input, O_RDONLY | O_CLOEXEC);
+		if (inFile < 0)
+			return -2;
+	}
+	if (prog->output != NULL) {			// redirect von Stdout auf file
+		if (debug)
+			printf("Output in %s\n", prog->output);
+		outFile = open(prog->output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+				0666);
+		if (outFile < 0) {
+			if (inFile >= 0)
+				close(inFile);
+			return -2;
+		}
 	}
 
-	pid = fork();					// Prozesse trennen
+	posix_spawn_file_actions_init(&actions);
+	if (closefd >= 0)
+		posix_spawn_file_actions_addclose(&actions, closefd);
+	if (infd >= 0) {
+		posix_spawn_file_actions_adddup2(&actions, infd, STDIN_FILENO);
+		posix_spawn_file_actions_addclose(&actions, infd);
+	}
+	if (outfd >= 0) {
+		posix_spawn_file_actions_adddup2(&actions, outfd, STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&actions, outfd);
+	}
+	if (inFile >= 0)					// dup2 loescht O_CLOEXEC im Kind
+		posix_spawn_file_actions_adddup2(&actions, inFile, STDIN_FILENO);
+	if (outFile >= 0)
+		posix_spawn_file_actions_adddup2(&actions, outFile, STDOUT_FILENO);
 
-	if (pid > 0) {					// Vaterprozess
-		if (!prog->background) {
-			waitpid(pid, 0, 0);		// Warten auf Kindprozess falls fg
+	if (group >= 0)
+		flags |= POSIX_SPAWN_SETPGROUP;
+	sigemptyset(&mask);
+	jobSignals(&defaults);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, flags);
+	posix_spawnattr_setpgroup(&attr, group);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	posix_spawnattr_setsigdefault(&attr, &defaults);	// von der Shell ignoriert
+
+	if (debug)
+		printf("posix_spawn(%s)\n", path);
+
+	error = posix_spawn(&pid, path, &actions, &attr, prog->argv, environ);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	if (inFile >= 0)
+		close(inFile);
+	if (outFile >= 0)
+		close(outFile);
+
+	if (error) {
+		fprintf(stderr, "%s: %s\n", prog->argv[0], strerror(error));
+		return -1;
+	}
+	return pid;
+}
+#endif
+
+/*
+ * Leitet stdin/stdout auf die angegebenen Dateien um und ersetzt den
+ * laufenden Prozess durch das Programm (kehrt nie zurueck)
+ */
+static void execProg(prog_args* prog, int dirfd, char* path) {
+	if (prog->input != NULL) {			// redirect von Stdin auf file
+		if (debug)
+			printf("Input von %s\n", prog->input);
+		int fd = open(prog->input, O_RDONLY);
+		if (fd < 0) {
+			perror(prog->input);
+			_exit(1);
 		}
-		return 0;
+		redirect(fd, STDIN_FILENO);
+	}
+	if (prog->output != NULL) {			// redirect von Stdout auf file
+		if (debug)
+			printf("Output in %s\n", prog->output);
+		int fd = open(prog->output, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd < 0) {
+			perror(prog->output);
+			_exit(1);
+		}
+		redirect(fd, STDOUT_FILENO);
+	}
 
-	} else if (pid == 0) { 			//Kindprozess
+	if (debug)
+		printf("exec(%s)\n", path);
+
+	execAt(dirfd, path, prog->argv);		// Programm ausfuehren
 
-		if (prog->input != NULL) {			// redirect von Stdin auf file
-			if (debug)
-				printf("Input von %s\n", prog->input);
-			freopen(prog->input, "r", stdin);
+	// Fallls exec nicht klappt, muss der Prozess beendet werden
+	perror("exec fail");
+	_exit(127);
+}
+
+/*
+ * Startet ein externes Programm als Kindprozess.
+ * infd/outfd	: Pipeenden fuer stdin/stdout (-1 = keine Pipe)
+ * closefd	: Pipeende, das nur der naechste Prozess braucht (-1 = keins)
+ * group	: Prozessgruppe des Kindes (0 = neue Gruppe mit PID des Kindes,
+ * 		  -1 = Gruppe der Shell, wenn es keine Jobkontrolle gibt)
+ * Je nach spawnMode mit posix_spawn() oder fork()+exec().
+ * Gibt die PID des Kindes zurueck, -1 bei Fehler
+ */
+static pid_t startProg(prog_args* prog, int infd, int outfd, int closefd,
+		pid_t group) {
+
+	int dirfd = -1;
+	char* path = NULL;				// NULL: Builtin in einer Kopie der Shell
+	struct timespec ts;
+	if (prog->builtin == EXTERNAL) {
+		STAT_START(ts);
+		path = whereIs(prog->argv[0], &dirfd);		// Programm suchen
+		STAT_STOP(STAT_LOOKUP, ts);
+		if (!path) {
+			fprintf(stderr, "%s: Programm nicht gefunden\n", prog->argv[0]);
+			return -1;
 		}
-		if (prog->output != NULL) {			// redirect von Stdout auf file
-			if (debug)
-				printf("Output in %s\n", prog->output);
-			freopen(prog->output, "w", stdout);
+	}
 
+	STAT_START(ts);
+#ifdef _POSIX_SPAWN
+	if (spawnMode == SPAWN_POSIX && path != NULL) {
+		pid = spawnProg(prog, path, infd, outfd, closefd, group);
+		if (pid != -2) {			// -2: Umleitung scheitert, wie -f melden
+			STAT_STOP(STAT_SPAWN, ts);
+			return pid;
 		}
+	}
+#endif
 
-		if (debug)
-			printf("exec(%s)\n", path);
+	pid = fork();					// Prozesse trennen
 
-		execv(path, prog->argv);			// Programm ausf�hren
+	if (pid > 0) {					// Vaterprozess
+		if (group >= 0)
+			setpgid(pid, group ? group : pid);	// auch hier, sonst Race mit exec
+		STAT_STOP(STAT_SPAWN, ts);
+		return pid;
+
+	} else if (pid == 0) { 			//Kindprozess
 
-		// Fallls exec nicht klappt, muss der Kindprozess beendet werden
-		perror("exec fail:\n");
-		exit(0);
+		if (group >= 0)
+			setpgid(0, group);
+
+		sigset_t empty, defaults;		// SIGCHLD ist in der Shell gerade blockiert
+		sigemptyset(&empty);
+		sigprocmask(SIG_SETMASK, &empty, NULL);
+		jobSignals(&defaults);			// von der Shell ignorierte Signale
+		int signo;
+		for (signo = 1; signo < NSIG; signo++)
+			if (sigismember(&defaults, signo) == 1)
+				signal(signo, SIG_DFL);
+
+		if (closefd >= 0)
+			close(closefd);
+		redirect(infd, STDIN_FILENO);
+		redirect(outfd, STDOUT_FILENO);
+
+		if (path == NULL)
+			_exit(runBuiltin(prog));	// leert stdout selbst
+		execProg(prog, dirfd, path);
 
 	} else
 		perror("fork() error!\n");
 
-	free(path);
-	return 0;
+	return -1;
 }
 
 /*
- * Fuehrt Befehlsliste aus
- * [-1,0,1] == [Fehler, OK, exit]
+ * Ersetzt die Shell durch das Programm (exec ohne fork), genutzt fuer
+ * das letzte Programm im -c Modus. Wird das Programm nicht gefunden,
+ * endet die Shell mit 127.
  */
-int doThis(cmds* liste) {
-	while (liste != NULL) {
-		cmds* currentCmd = liste;
-		liste = liste->next;
-
-		/*
-		 * Bei exit die Shell beenden
-		 */
-		if (currentCmd->kind == EXIT) {
-			return 1;
-		}
+static void replaceShell(prog_args* prog) {
+	int dirfd;
+	char* path = whereIs(prog->argv[0], &dirfd);
+	if (!path) {
+		fprintf(stderr, "%s: Programm nicht gefunden\n", prog->argv[0]);
+		exit(127);
+	}
+	fflush(NULL);						// sonst gehen gepufferte Ausgaben verloren
+	execProg(prog, dirfd, path);
+}
 
-		/*
-		 * CD bringt einen neuen Pfad, der mittels chdir() veraendert wird.
-		 */
-		if (currentCmd->kind == CD) {
-			chdir(currentCmd->cd.path);
-			continue;
+/*
+ * Wartet auf die Threads der Builtins einer Pipe (wait) oder laesst sie
+ * allein weiterlaufen, sie raeumen dann selbst auf
+ */
+static int finishStages(stage_threads* stages, int wait) {
+	int i;
+	void* result = (void*) 0;
+
+	for (i = 0; i < stages->num; i++) {
+		if (wait)
+			pthread_join(stages->thread[i], &result);
+		else
+			pthread_detach(stages->thread[i]);
+	}
+	stages->num = 0;
+	return (int) (intptr_t) result;		// Status des letzten Builtins
+}
+
+/*
+ * Hilfsfunktion zum Ausfuehren eines externen Programms
+ * Informationen dazu in der Doku
+ */
+int executeProg(prog_args* prog) {
+	return executePipe(prog);
+}
+
+/*
+ * Fuehrt eine Pipe (oder ein einzelnes Programm) aus.
+ * Zwischen je zwei Programmen liegt eine pipe(2), alle Programme werden
+ * gestartet, bevor gewartet wird, und laufen in einer gemeinsamen
+ * Prozessgruppe (der des ersten Programms).
+ * Ist das letzte Programm ein Hintergrundprozess, wird nicht gewartet.
+ * Jede Pipe wird als Job eingetragen, eingesammelt werden die Prozesse
+ * vom SIGCHLD-Handler (Jobs.c).
+ */
+int executePipe(prog_args* first) {
+	prog_args* last = first;
+	stage_threads stages = { 0 };
+	sigset_t old;
+	struct timespec start;
+	int error = 0;
+
+	while (last->next != NULL)
+		last = last->next;
+
+	blockChild(&old);					// kein SIGCHLD bevor der Job existiert
+	if (first->timed)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	/*
+	 * Mit time und im Hintergrund laufen Builtins in Kindprozessen (fork
+	 * der Shell): sonst fehlt ihre rusage bzw. die Shell muesste auf die
+	 * Threads warten, und & waere wirkungslos
+	 */
+	job* j = startPipe(first, -1, jobControlOn,
+			first->timed || last->background ? NULL : &stages, &error);
+	if (j == NULL) {					// Fehler oder nur Builtins
+		unblockChild(&old);
+		lastStatus = finishStages(&stages, 1);
+		if (error)
+			lastStatus = 127;
+		return error ? -1 : 0;
+	}
+	if (first->timed)
+		timeJob(j, &start);				// Messwerte sammelt der SIGCHLD-Handler
+	if (!last->background || error) {	// Warten auf alle Kindprozesse falls fg
+		struct timespec ts;
+		unblockChild(&old);
+		STAT_START(ts);
+		int status = waitJob(j, 0);
+		int stopped = status == -1;
+		// angehalten: die Builtins koennen an der vollen Pipe haengen
+		finishStages(&stages, !stopped);
+		STAT_STOP(STAT_WAIT, ts);
+		lastStatus = error ? 127 : stopped ? 128 + SIGTSTP : status;
+		return error ? -1 : 0;
+	}
+	finishStages(&stages, 0);
+	if (jobControlOn)
+		printf("[%d] %d\n", j->id, j->pgid);
+	unblockChild(&old);
+
+	return error ? -1 : 0;
+}
+
+/*
+ * Startet alle Programme einer Pipe und traegt sie als Job ein.
+ * outfd	: stdout des letzten Programms (-1 = stdout der Shell)
+ * ownGroup	: Job in eigener Prozessgruppe (sonst in der der Shell)
+ * stages	: Builtins laufen in Threads, die hier eingetragen werden
+ * 		  (NULL = alle Stufen als Prozesse, Builtins per fork())
+ * Die Threads starten erst nach dem letzten fork(), der Kindprozess
+ * erbt so keine halb benutzten Sperren.
+ * Muss mit blockiertem SIGCHLD aufgerufen werden. Gibt den Job zurueck,
+ * NULL wenn kein Programm gestartet wurde; *error wird bei Fehlern gesetzt.
+ */
+job* startPipe(prog_args* first, int outfd, int ownGroup,
+		stage_threads* stages, int* error) {
+	pid_t pids[MAX_PIPE_LENGTH];
+	prog_args* builtins[MAX_PIPE_LENGTH];	// noch zu startende Builtins
+	int builtinfds[MAX_PIPE_LENGTH];
+	int num = 0; 						// Zaehlt die Programme in der Pipe
+	int numBuiltins = 0, i;
+	int infd = -1;						// Leseende der vorherigen Pipe
+	prog_args* iteratePipe;
+
+	fflush(NULL);						// eigene Ausgaben vor denen der Kinder
+
+	for (iteratePipe = first; iteratePipe != NULL; iteratePipe = iteratePipe->next) {
+		int fds[2] = { -1, -1 };
+
+		if (num + numBuiltins == MAX_PIPE_LENGTH) {
+			fprintf(stderr, "Pipe zu lang (max. %d Programme)\n", MAX_PIPE_LENGTH);
+			*error = 1;
+			break;
+		}
+		// O_CLOEXEC: kein Kind darf fremde Pipeenden offen halten
+		if (iteratePipe->next != NULL && pipe2(fds, O_CLOEXEC) < 0) {
+			perror("pipe() error");
+			*error = 1;
+			break;
 		}
 
-		/*
-		 * unsetenv hat keinen value,
-		 * setenv hat Value und ueberschreibt vorhandene ENVs
-		 */
-		if (currentCmd->kind == ENV) {
-			if (currentCmd->env.value == NULL) {
-				unsetenv(currentCmd->env.name);
-			} else
-				setenv(currentCmd->env.name, currentCmd->env.value, 1);
-			// 1 um evtl gesetzten Wert einfach zu ueberschreiben, 0 um alten Wert zu nutzen
+		if (stages != NULL && iteratePipe->builtin != EXTERNAL) {
+			// Builtin: Schreibende merken, Leseende wird nicht gebraucht
+			builtins[numBuiltins] = iteratePipe;
+			builtinfds[numBuiltins++] = iteratePipe->next ? fds[1] : outfd;
+			if (infd >= 0)
+				close(infd);
+			infd = fds[0];
 			continue;
 		}
 
-		/*
-		 *	Jobcontol
-		 */
-		if (currentCmd->kind == JOB) {
-			printf("noch nicht implementiert\n");
+		// mit Jobkontrolle eine eigene Prozessgruppe je Job
+		pid_t child = startProg(iteratePipe, infd,
+				iteratePipe->next ? fds[1] : outfd, fds[0],
+				!ownGroup ? -1 : num ? pids[0] : 0);
+
+		// Vater braucht nur das Leseende fuer das naechste Programm
+		if (infd >= 0)
+			close(infd);
+		if (fds[1] >= 0)
+			close(fds[1]);
+		infd = fds[0];
+
+		if (child < 0) {
+			*error = 1;
 			break;
 		}
+		pids[num++] = child;
+	}
+	if (infd >= 0)
+		close(infd);
 
-		/*
-		 * Piping
-		 * Ueber gegebene PIPE iterieren
-		 * Dabei die Ausgabe des aktuellen Programms cachen,
-		 * naechstes Programm mit cache fuettern und starten
-		 * Erstes und letztes Programm bekommten I/O wieder auf tty
-		 */
-		if (currentCmd->kind == PIPE) {
-			int num = 0; //Zaehlt die Programme in der Pipe
-			char cache[265], cache2[265];
-
-			prog_args* iteratePipe = &currentCmd->prog;
-
-			while (iteratePipe->next != NULL) {
-				// alterniert PipeCacheFiles fuer pipes mit Laenge > 2
-				if (num % 2 == 0) {
-					strcpy(cache, PIPE1);
-					iteratePipe->output = cache;		// redirect von Stdout auf tempfile
-				} else {
-					strcpy(cache2, PIPE2);
-					iteratePipe->output = cache2;	// redirect von Stdout auf tempfile
-				}
-
-				if (executeProg(iteratePipe) < 0) {
-					perror("Fehler bei der Programmausfuehrung!\n");
-					break;
-				}
-
-				if (num % 2 == 0) {
-					iteratePipe->next->input = cache;	// input des folgenden Programms auf tempfile
-				} else {
-					iteratePipe->next->input = cache2;	// input des folgenden Programms auf tempfile
-				}
-
-				iteratePipe = iteratePipe->next;
-
-				num++;
-			}
-
-			executeProg(iteratePipe);		//letztes PipeProgramm ausfuehren
-		}
+	for (i = 0; i < numBuiltins; i++) {
+		if (*error) {
+			if (builtinfds[i] >= 0)
+				close(builtinfds[i]);
+		} else if (startStage(builtins[i], builtinfds[i],
+				&stages->thread[stages->num]) == 0)
+			stages->num++;
+		else
+			*error = 1;
+	}
 
-		/*
-		 * Programmausfuehrung
-		 * Methode absrahiert um diese fuer Piping zu nutzen
-		 */
-		if (currentCmd->kind == PROG) {
-			executeProg(&currentCmd->prog);
-			continue;
+	if (num == 0)
+		return NULL;
 
+	job* j = addJob(pids, num, first);
+	if (j == NULL) {
+		perror("Job");
+		*error = 1;
+	} else if (!ownGroup)
+		j->pgid = 0;					// Signale dann einzeln an die Prozesse
+	return j;
+}
+
+/*
+ * Ein Handler je Befehlsart (enum cmd_kind), last ist gesetzt, wenn der
+ * Befehl der letzte der Liste ist.
+ * [-1,0,1] == [Fehler, OK, exit]
+ * Der Exitstatus des letzten Befehls steht danach in lastStatus.
+ */
+typedef int (*cmd_handler)(cmds* cmd, int last);
+
+/*
+ * Bei exit die Shell beenden
+ */
+static int doExit(cmds* cmd, int last) {
+	return 1;
+}
+
+/*
+ * CD bringt einen neuen Pfad, der mittels chdir() veraendert wird.
+ */
+static int doCd(cmds* cmd, int last) {
+	if (chdir(cmd->cd.path) == 0) {
+		cwdChanged = 1;
+		forgetCwdHash();		// "." in $PATH zeigt jetzt woanders hin
+	} else
+		lastStatus = 1;
+	return 0;
+}
+
+/*
+ * setenv setzt und exportiert, set setzt nur in der Shell (siehe Vars.c),
+ * export exportiert eine Variable der Shell, unsetenv loescht
+ */
+static int doEnv(cmds* cmd, int last) {
+	char* name = cmd->env.name;
+	switch (cmd->env.kind) {
+	case ENV_SETENV:
+	case ENV_SET:
+		if (setVar(name, cmd->env.value, cmd->env.kind == ENV_SETENV) < 0) {
+			perror(name);
+			lastStatus = 1;
 		}
+		break;
+	case ENV_EXPORT:
+		if (exportVar(name) < 0) {
+			fprintf(stderr, "export: %s ist nicht gesetzt\n", name);
+			lastStatus = 1;
+		}
+		break;
+	case ENV_UNSET:
+		unsetVar(name);
+		break;
 	}
+	if (!strcmp(name, "PATH"))
+		updatePath();			// Suchordner neu oeffnen
 	return 0;
 }
 
+/*
+ * hash zeigt die gemerkten Programmpfade,
+ * hash -r bzw. rehash vergisst sie
+ */
+static int doHash(cmds* cmd, int last) {
+	if (cmd->hash.reset)
+		clearHash();
+	else
+		printHash();
+	return 0;
+}
+
+/*
+ * source liest ein Skript und fuehrt es in dieser Shell aus,
+ * ein exit im Skript beendet auch die Shell
+ */
+static int doSource(cmds* cmd, int last) {
+	// -c: kein Befehl des Skripts ist der letzte der Befehlsliste
+	int savedExecLast = execLast;
+	execLast = 0;
+	int result = runScript(cmd->source.path);
+	execLast = savedExecLast;
+	if (result < 0)
+		lastStatus = 1;				// sonst Status des letzten Skriptbefehls
+	return result == 1;
+}
+
+/*
+ * parallel startet den Befehl fuer jedes item, hoechstens -j
+ * gleichzeitig, und meldet wie viele fehlgeschlagen sind
+ */
+static int doParallel(cmds* cmd, int last) {
+	int failed = executeParallel(&cmd->parallel);
+	if (failed > 0) {
+		fprintf(stderr, "parallel: %d von %d Befehlen fehlgeschlagen\n",
+				failed, cmd->parallel.count);
+		lastStatus = 1;
+	}
+	return 0;
+}
+
+/*
+ * stats zeigt die gemessenen Latenzen, on/off schaltet die
+ * Messung, reset loescht sie
+ */
+static int doStats(cmds* cmd, int last) {
+	switch (cmd->stats.kind) {
+	case STATS_SHOW:
+		printStats();
+		break;
+	case STATS_ON:
+		statsOn = 1;
+		break;
+	case STATS_OFF:
+		statsOn = 0;
+		break;
+	case STATS_RESET:
+		resetStats();
+	}
+	return 0;
+}
+
+/*
+ *	Jobcontol
+ */
+static int doJob(cmds* cmd, int last) {
+	int status = jobControl(&cmd->job);	// fg: Status des Jobs
+	lastStatus = status < 0 ? 1 : status;
+	return 0;
+}
+
+/*
+ * Piping
+ * Alle Programme der Pipe laufen gleichzeitig und sind ueber
+ * pipe(2) verbunden, erstes und letztes Programm bekommen
+ * I/O wieder auf tty bzw. die angegebenen Dateien
+ */
+static int doPipe(cmds* cmd, int last) {
+	if (executePipe(&cmd->prog) < 0)
+		fprintf(stderr, "Fehler bei der Programmausfuehrung!\n");
+	return 0;
+}
+
+/*
+ * Programmausfuehrung
+ * Methode absrahiert um diese fuer Piping zu nutzen
+ */
+static int doProg(cmds* cmd, int last) {
+	prog_args* prog = &cmd->prog;
+	if (prog->builtin != EXTERNAL && !prog->background && !prog->timed) {
+		lastStatus = runBuiltin(prog);
+		if (execLast && last)
+			exit(lastStatus);		// -c: Status wie beim exec()
+		return 0;
+	}
+	if (execLast && last && !prog->background && !prog->timed)
+		replaceShell(prog);	// kehrt nicht zurueck
+	executeProg(prog);
+	return 0;
+}
+
+static const cmd_handler handlers[] = {
+	[EXIT] = doExit,
+	[CD] = doCd,
+	[ENV] = doEnv,
+	[JOB] = doJob,
+	[HASH] = doHash,
+	[SOURCE] = doSource,
+	[PARALLEL] = doParallel,
+	[STATS] = doStats,
+	[PROG] = doProg,
+	[PIPE] = doPipe
+};
+
+/*
+ * Fuehrt Befehlsliste aus
+ * [-1,0,1] == [Fehler, OK, exit]
+ */
+int doThis(cmds* liste) {
+	for (; liste != NULL; liste = liste->next) {
+		if (liste->kind != EXIT)
+			lastStatus = 0;		// Handler setzen nur Fehler und Jobstatus
+		if (handlers[liste->kind](liste, liste->next == NULL) == 1)
+			return 1;
+	}
+	return 0;
+}
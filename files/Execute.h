@@ -1,6 +1,32 @@
 
-pid_t shell_pgid, pid, pgid;
+#include <pthread.h>
 
+extern pid_t shell_pgid, pid, pgid;
+
+enum spawn_mode {
+	SPAWN_FORK,		// fork() + exec()
+	SPAWN_POSIX		// posix_spawn() (vfork-Semantik)
+};
+
+extern int spawnMode;
+extern int cwdChanged;		// cd war erfolgreich, Prompt neu bauen
+extern int execLast;		// -c Modus: letztes Programm per exec() ohne fork()
+extern int lastStatus;		// Exitstatus des letzten Befehls
+
+#define MAX_PIPE_LENGTH 256	// maximale Anzahl Programme in einer Pipe
+
+/*
+ * Builtins einer Pipe, die in Threads der Shell laufen
+ */
+typedef struct stage_threads {
+	int num;
+	pthread_t thread[MAX_PIPE_LENGTH];
+} stage_threads;
 
 int getExitShell();
+int executeProg(prog_args* prog);
+int executePipe(prog_args* first);
+struct job* startPipe(prog_args* first, int outfd, int ownGroup,
+		stage_threads* stages, int* error);
+int executeParallel(parallel_args* par);
 int doThis(cmds* liste);
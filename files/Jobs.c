@@ -0,0 +1,496 @@
+/*
+ * Jobs.c
+ *
+ *  Jobtabelle und Jobkontrolle
+ *  - jobs [id]	:	Jobs anzeigen
+ *  - bg [id]	:	angehaltenen Job im Hintergrund fortsetzen
+ *  - fg [id]	:	Job in den Vordergrund holen
+ *
+ *  Kindprozesse werden asynchron im SIGCHLD-Handler eingesammelt
+ *  (waitpid(-1, WNOHANG) in einer Schleife), es bleiben also keine
+ *  Zombies liegen. Die Liste selbst wird nur mit blockiertem SIGCHLD
+ *  veraendert, der Handler aendert nur Zustaende vorhandener Jobs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "Parser.h"
+#include "Execute.h"
+#include "Jobs.h"
+
+int jobControlOn;
+
+static job* jobs;			// aelteste Jobs zuerst
+static job* lastJob;		// juengster Job (hat die hoechste Nummer)
+static struct termios shellModes;	// Terminaleinstellungen der Shell
+
+/*
+ * Macht die Prozessgruppe group zur Vordergrundgruppe des Terminals.
+ * Nur mit Jobkontrolle: dann ignoriert die Shell SIGTTOU, sonst wuerde
+ * der Kernel sie anhalten, wenn sie das Terminal aus dem Hintergrund
+ * zurueckholt.
+ */
+static void giveTerminal(pid_t group) {
+	tcsetpgrp(STDIN_FILENO, group);
+}
+
+/*
+ * Traegt den neuen Zustand eines Prozesses in seinen Job ein
+ * (wird nur im SIGCHLD-Handler aufgerufen)
+ */
+static void updateJob(pid_t pid, int status, struct rusage* ru) {
+	job* j;
+	int i;
+
+	for (j = jobs; j != NULL; j = j->next) {
+		for (i = 0; i < j->num; i++) {
+			if (j->pids[i] != pid)
+				continue;
+			if (WIFSTOPPED(status)) {
+				if (j->state != JOB_STOPPED)	// nur einmal pro Pipe melden
+					j->notified = 0;
+				j->state = JOB_STOPPED;
+			} else if (WIFCONTINUED(status)) {
+				j->state = JOB_RUNNING;
+			} else {
+				if (i == j->num - 1)
+					j->status = status;		// Status der Pipe = letztes Programm
+				if (j->usage != NULL) {		// time: Messwerte merken
+					j->usage[i].ru = *ru;
+					clock_gettime(CLOCK_MONOTONIC, &j->usage[i].end);
+				}
+				if (--j->running == 0) {
+					j->state = JOB_DONE;
+					j->notified = 0;
+				}
+			}
+			return;
+		}
+	}
+}
+
+/*
+ * Sammelt alle beendeten/angehaltenen Kinder ein; wait4() liefert
+ * zusaetzlich die Ressourcen des Kindes (fuer time)
+ */
+static void childHandler(int signo) {
+	int saved = errno;			// errno des unterbrochenen Codes retten
+	int status;
+	struct rusage ru;
+	pid_t pid;
+
+	while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &ru)) > 0)
+		updateJob(pid, status, &ru);
+
+	errno = saved;
+}
+
+/*
+ * Signale, die eine interaktive Shell ignoriert und die Kinder wieder
+ * auf SIG_DFL setzen muessen (ignorierte Signale ueberleben exec())
+ */
+void jobSignals(sigset_t* set) {
+	sigemptyset(set);
+	sigaddset(set, SIGTSTP);
+	sigaddset(set, SIGTTIN);
+	sigaddset(set, SIGTTOU);
+}
+
+/*
+ * Interaktiv (stdin ist ein Terminal) wird die Shell Anfuehrer ihrer
+ * eigenen Prozessgruppe und Vordergrundgruppe des Terminals. Strg+C und
+ * Strg+Z gehen dann nur an die Gruppe des Vordergrundjobs.
+ */
+void initJobs(int interactive) {
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = childHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;		// readline & Co. nicht unterbrechen
+	sigaction(SIGCHLD, &action, NULL);
+
+	shell_pgid = getpid();
+	if (!interactive || !isatty(STDIN_FILENO))
+		return;
+
+	// im Hintergrund gestartet? Warten bis wir in den Vordergrund kommen
+	pid_t group;
+	while (tcgetpgrp(STDIN_FILENO) != (group = getpgrp()))
+		kill(-group, SIGTTIN);
+
+	signal(SIGTSTP, SIG_IGN);			// Strg+Z haelt nicht die Shell an
+	signal(SIGTTIN, SIG_IGN);
+	signal(SIGTTOU, SIG_IGN);			// tcsetpgrp() aus dem Hintergrund
+
+	if (group != shell_pgid && setpgid(0, shell_pgid) < 0) {
+		perror("setpgid");
+		return;
+	}
+	tcsetpgrp(STDIN_FILENO, shell_pgid);
+	tcgetattr(STDIN_FILENO, &shellModes);
+	jobControlOn = 1;
+}
+
+/*
+ * Schickt dem Job ein Signal: mit Jobkontrolle ein kill() an die ganze
+ * Prozessgruppe, sonst an jeden Prozess einzeln
+ */
+static void signalJob(job* j, int signo) {
+	int i;
+
+	if (j->pgid > 0) {
+		kill(-j->pgid, signo);
+		return;
+	}
+	for (i = 0; i < j->num; i++)
+		kill(j->pids[i], signo);
+}
+
+/*
+ * SIGCHLD blockieren bzw. alten Zustand wiederherstellen,
+ * solange die Jobliste veraendert wird
+ */
+void blockChild(sigset_t* old) {
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, old);
+}
+
+void unblockChild(sigset_t* old) {
+	sigprocmask(SIG_SETMASK, old, NULL);
+}
+
+/*
+ * Baut die Befehlszeile einer Pipe fuer die Anzeige zusammen
+ */
+static char* jobText(prog_args* first) {
+	prog_args* prog;
+	size_t len = 1;
+	int i;
+
+	for (prog = first; prog != NULL; prog = prog->next) {
+		for (i = 0; i < prog->argc; i++)
+			len += strlen(prog->argv[i]) + 1;
+		len += 4;						// " | " bzw. " &"
+	}
+
+	char* text = malloc(len);
+	if (text == NULL)
+		return NULL;
+	char* end = text;					// stpcpy statt strcat: linear
+	*end = '\0';
+	for (prog = first; prog != NULL; prog = prog->next) {
+		for (i = 0; i < prog->argc; i++) {
+			if (i > 0)
+				end = stpcpy(end, " ");
+			end = stpcpy(end, prog->argv[i]);
+		}
+		if (prog->next != NULL)
+			end = stpcpy(end, " | ");
+		else if (prog->background)
+			end = stpcpy(end, " &");
+	}
+	return text;
+}
+
+/*
+ * Legt einen Job fuer bereits gestartete Prozesse an.
+ * Muss mit blockiertem SIGCHLD aufgerufen werden (seit vor dem Start
+ * des ersten Prozesses), sonst koennte ein Prozess eingesammelt werden,
+ * bevor sein Job existiert.
+ */
+job* addJob(pid_t* pids, int num, prog_args* first) {
+	job* j = malloc(sizeof(job) + num * sizeof(pid_t));
+	if (j == NULL)
+		return NULL;
+
+	j->id = lastJob ? lastJob->id + 1 : 1;
+	j->pgid = jobControlOn ? pids[0] : 0;
+	j->text = jobText(first);
+	j->state = JOB_RUNNING;
+	j->running = num;
+	j->status = 0;
+	j->notified = 0;
+	j->hasModes = 0;
+	j->usage = NULL;
+	j->next = NULL;
+	j->num = num;
+	memcpy(j->pids, pids, num * sizeof(pid_t));
+
+	if (lastJob)
+		lastJob->next = j;
+	else
+		jobs = j;
+	lastJob = j;
+	return j;
+}
+
+/*
+ * Haengt den Job hinter before aus (before == NULL: erster Job)
+ * und gibt ihn frei (SIGCHLD muss blockiert sein)
+ */
+static void unlinkJob(job* before, job* j) {
+	if (before)
+		before->next = j->next;
+	else
+		jobs = j->next;
+	if (lastJob == j)
+		lastJob = before;
+	free(j->usage);
+	free(j->text);
+	free(j);
+}
+
+/*
+ * Entfernt einen Job aus der Liste (SIGCHLD muss blockiert sein)
+ */
+void removeJob(job* j) {
+	job* before = NULL;
+	job* k;
+
+	for (k = jobs; k != NULL && k != j; k = k->next)
+		before = k;
+	if (k != NULL)
+		unlinkJob(before, j);
+}
+
+static const char* stateText(job* j) {
+	static char text[32];
+
+	switch (j->state) {
+	case JOB_RUNNING:
+		return "Laeuft";
+	case JOB_STOPPED:
+		return "Angehalten";
+	default:
+		if (WIFSIGNALED(j->status))
+			snprintf(text, sizeof(text), "Signal %d", WTERMSIG(j->status));
+		else if (WEXITSTATUS(j->status))
+			snprintf(text, sizeof(text), "Fertig (%d)", WEXITSTATUS(j->status));
+		else
+			return "Fertig";
+		return text;
+	}
+}
+
+static void printJob(job* j) {
+	printf("[%d]%c  %-12s %s\n", j->id, j == lastJob ? '+' : ' ',
+			stateText(j), j->text ? j->text : "");
+}
+
+/*
+ * Schaltet die Messung fuer time ein (SIGCHLD muss blockiert sein,
+ * seit vor dem Start der Programme)
+ */
+void timeJob(job* j, struct timespec* start) {
+	j->usage = calloc(j->num, sizeof(stage_usage));
+	j->start = *start;
+}
+
+static double seconds(struct timeval* tv) {
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void printStage(char* name, double real, double user, double sys,
+		long maxrss, long minflt, long majflt, long nvcsw, long nivcsw) {
+	fprintf(stderr, "%-8s %9.3fs %9.3fs %9.3fs %8ldk %8ld %8ld %8ld %8ld\n",
+			name, real, user, sys, maxrss, minflt, majflt, nvcsw, nivcsw);
+}
+
+/*
+ * Gibt die Messwerte von time aus: je Programm der Pipe und gesamt.
+ * Gesamt: real bis zum Ende des letzten Programms, CPU-Zeiten, Faults
+ * und Kontextwechsel summiert, maxrss als Maximum der Programme.
+ */
+static void printUsage(job* j) {
+	double real, maxReal = 0, user = 0, sys = 0;
+	long maxrss = 0, minflt = 0, majflt = 0, nvcsw = 0, nivcsw = 0;
+	char name[16];
+	int i;
+
+	fprintf(stderr, "time: %s\n", j->text ? j->text : "");
+	fprintf(stderr, "%-8s %10s %10s %10s %9s %8s %8s %8s %8s\n", "", "real",
+			"user", "sys", "maxrss", "minflt", "majflt", "vcsw", "ivcsw");
+	for (i = 0; i < j->num; i++) {
+		struct rusage* ru = &j->usage[i].ru;
+		real = (j->usage[i].end.tv_sec - j->start.tv_sec)
+				+ (j->usage[i].end.tv_nsec - j->start.tv_nsec) / 1e9;
+		if (j->num > 1) {
+			snprintf(name, sizeof(name), "[%d]", i + 1);
+			printStage(name, real, seconds(&ru->ru_utime), seconds(&ru->ru_stime),
+					ru->ru_maxrss, ru->ru_minflt, ru->ru_majflt, ru->ru_nvcsw,
+					ru->ru_nivcsw);
+		}
+		if (real > maxReal)
+			maxReal = real;
+		user += seconds(&ru->ru_utime);
+		sys += seconds(&ru->ru_stime);
+		if (ru->ru_maxrss > maxrss)
+			maxrss = ru->ru_maxrss;
+		minflt += ru->ru_minflt;
+		majflt += ru->ru_majflt;
+		nvcsw += ru->ru_nvcsw;
+		nivcsw += ru->ru_nivcsw;
+	}
+	printStage("gesamt", maxReal, user, sys, maxrss, minflt, majflt, nvcsw,
+			nivcsw);
+}
+
+/*
+ * Wartet bis der Job nicht mehr laeuft; der Job bekommt solange das
+ * Terminal (cont: danach mit SIGCONT fortsetzen). Beendete Jobs werden
+ * entfernt, angehaltene gemeldet.
+ * Gibt den Exitstatus zurueck (128+n bei Signal n, -1 falls angehalten)
+ */
+int waitJob(job* j, int cont) {
+	sigset_t old, suspend;
+	int result = -1;
+
+	blockChild(&old);
+	suspend = old;
+	sigdelset(&suspend, SIGCHLD);
+
+	if (jobControlOn) {
+		giveTerminal(j->pgid);
+		if (cont && j->hasModes)
+			tcsetattr(STDIN_FILENO, TCSADRAIN, &j->modes);
+	}
+	if (cont) {
+		j->state = JOB_RUNNING;
+		signalJob(j, SIGCONT);
+	}
+	while (j->state == JOB_RUNNING)
+		sigsuspend(&suspend);				// schlafen bis SIGCHLD kommt
+	if (jobControlOn) {
+		// Terminal zurueckholen, Einstellungen des Jobs fuer fg merken
+		if (j->state == JOB_STOPPED)
+			j->hasModes = !tcgetattr(STDIN_FILENO, &j->modes);
+		giveTerminal(shell_pgid);
+		tcsetattr(STDIN_FILENO, TCSADRAIN, &shellModes);
+	}
+
+	if (j->state == JOB_DONE) {
+		if (WIFSIGNALED(j->status))
+			result = 128 + WTERMSIG(j->status);
+		else
+			result = WEXITSTATUS(j->status);
+		if (j->usage != NULL)
+			printUsage(j);
+		removeJob(j);
+	} else {
+		printf("\n");
+		printJob(j);
+		j->notified = 1;
+	}
+
+	unblockChild(&old);
+	return result;
+}
+
+/*
+ * Zeigt Zustandsaenderungen an (verbose) und entfernt beendete Jobs.
+ * Wird vor jedem Prompt aufgerufen, in Skripten ohne Ausgabe.
+ */
+void reportJobs(int verbose) {
+	sigset_t old;
+	job* j;
+	job* next;
+	job* before = NULL;
+
+	blockChild(&old);
+	for (j = jobs; j != NULL; j = next) {
+		next = j->next;
+		if (!j->notified && j->state != JOB_RUNNING) {
+			if (verbose)
+				printJob(j);
+			j->notified = 1;
+		}
+		if (j->state == JOB_DONE) {
+			if (j->usage != NULL)
+				printUsage(j);				// time ... &
+			unlinkJob(before, j);			// before bleibt Vorgaenger
+		}
+		else
+			before = j;
+	}
+	unblockChild(&old);
+}
+
+/*
+ * Sucht den Job mit der Nummer id, bei -1 den juengsten noch
+ * nicht beendeten Job (SIGCHLD muss blockiert sein)
+ */
+static job* findJob(int id) {
+	job* j;
+	job* found = NULL;
+
+	for (j = jobs; j != NULL; j = j->next) {
+		if (id == -1 ? j->state != JOB_DONE : j->id == id)
+			found = j;
+	}
+	return found;
+}
+
+/*
+ * Fuehrt jobs, bg und fg aus
+ */
+int jobControl(job_args* args) {
+	sigset_t old;
+	job* j;
+
+	blockChild(&old);
+
+	if (args->kind == INFO && args->id == -1) {
+		for (j = jobs; j != NULL; j = j->next) {
+			printJob(j);
+			if (j->state != JOB_RUNNING)
+				j->notified = 1;
+		}
+		unblockChild(&old);
+		reportJobs(0);					// gemeldete fertige Jobs entfernen
+		return 0;
+	}
+
+	j = findJob(args->id);
+	if (j == NULL) {
+		unblockChild(&old);
+		if (args->id == -1)
+			fprintf(stderr, "Keine Jobs vorhanden\n");
+		else
+			fprintf(stderr, "Job %d nicht gefunden\n", args->id);
+		return -1;
+	}
+
+	switch (args->kind) {
+	case INFO:
+		printJob(j);
+		unblockChild(&old);
+		return 0;
+
+	case BG:
+		if (j->state == JOB_STOPPED) {
+			j->state = JOB_RUNNING;
+			signalJob(j, SIGCONT);			// ein Signal fuer die ganze Pipe
+		}
+		printf("[%d]  %s\n", j->id, j->text ? j->text : "");
+		unblockChild(&old);
+		return 0;
+
+	case FG:
+		printf("%s\n", j->text ? j->text : "");
+		unblockChild(&old);
+		return waitJob(j, j->state == JOB_STOPPED);
+	}
+
+	unblockChild(&old);
+	return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Jobs.h
+ */
+
+#include <sys/types.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/resource.h>
+
+enum job_state {
+	JOB_RUNNING,		// mindestens ein Prozess laeuft noch
+	JOB_STOPPED,		// angehalten (Strg+Z, SIGSTOP)
+	JOB_DONE			// alle Prozesse beendet
+};
+
+/*
+ * Messwerte eines Programms fuer time (vom SIGCHLD-Handler gefuellt)
+ */
+typedef struct stage_usage {
+	struct rusage ru;				// von wait4()
+	struct timespec end;			// Ende (CLOCK_MONOTONIC)
+} stage_usage;
+
+/*
+ * Ein Job ist ein Programm oder eine Pipe. Die Prozesse eines Jobs
+ * laufen in einer eigenen Prozessgruppe (pgid = PID des ersten), ohne
+ * Jobkontrolle (Skripte, -c) in der Gruppe der Shell (pgid = 0).
+ * state/running/status werden vom SIGCHLD-Handler geaendert.
+ */
+typedef struct job {
+	int id;							// Jobnummer fuer jobs/fg/bg
+	pid_t pgid;						// Prozessgruppe des Jobs
+	char* text;						// Befehlszeile zur Anzeige
+	volatile sig_atomic_t state;	// enum job_state
+	volatile sig_atomic_t running;	// Prozesse, die noch nicht beendet sind
+	volatile sig_atomic_t status;	// waitpid-Status des letzten Programms
+	volatile sig_atomic_t notified;	// Zustand schon angezeigt?
+	struct termios modes;			// Terminaleinstellungen beim Anhalten
+	int hasModes;					// modes gueltig?
+	stage_usage* usage;				// je Programm, nur bei time (sonst NULL)
+	struct timespec start;			// Start des Jobs (nur bei time)
+	struct job* next;
+	int num;						// Anzahl Prozesse
+	pid_t pids[];					// PIDs (letzte = Ende der Pipe)
+} job;
+
+extern int jobControlOn;		// Jobs in eigenen Gruppen, Terminal wechselt
+
+void initJobs(int interactive);
+void jobSignals(sigset_t* set);
+void blockChild(sigset_t* old);
+void unblockChild(sigset_t* old);
+job* addJob(pid_t* pids, int num, prog_args* first);
+int waitJob(job* j, int cont);
+void removeJob(job* j);
+void reportJobs(int verbose);
+void timeJob(job* j, struct timespec* start);
+int jobControl(job_args* args);
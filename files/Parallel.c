@@ -0,0 +1,284 @@
+/*
+ * Parallel.c
+ *
+ *  Builtin parallel [-j n] [-k] befehl [args] ::: items
+ *  - fuehrt befehl fuer jedes item aus (jedes {} in den Argumenten wird
+ *    ersetzt, auch innerhalb wie in {}.gz, sonst wird das item angehaengt)
+ *  - hoechstens n Befehle gleichzeitig (Voreinstellung: Anzahl CPUs)
+ *  - sobald einer fertig ist, startet der naechste
+ *  - Ausgaben werden pro Befehl gesammelt und am Stueck ausgegeben,
+ *    mit -k in der Reihenfolge der items, sonst in der der Fertigstellung
+ *  - Rueckgabe: Anzahl fehlgeschlagener Befehle
+ */
+
+#define _GNU_SOURCE		// ppoll, pipe2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "Parser.h"
+#include "Execute.h"
+#include "Jobs.h"
+
+#define READ_SIZE 65536		// so viel wird pro read() gelesen
+
+typedef struct task {
+	prog_args prog;			// Befehl mit eingesetztem item
+	job* j;					// laufender Job (NULL = nicht gestartet/fertig)
+	int fd;					// Leseende der Ausgabepipe (-1 = EOF)
+	char* out;				// gesammelte Ausgabe
+	size_t len, size;
+	int done;				// Job beendet und Ausgabe komplett
+	int status;				// Exitstatus
+} task;
+
+/*
+ * Zaehlt die {} in arg
+ */
+static int countBraces(char* arg) {
+	int n = 0;
+	while ((arg = strstr(arg, "{}")) != NULL) {
+		n++;
+		arg += 2;
+	}
+	return n;
+}
+
+/*
+ * Baut den Argumentvektor fuer ein item: jedes {} in jedem Argument wird
+ * durch das item ersetzt (auch x{}.gz oder out/{}), kommt {} nirgends vor,
+ * wird das item angehaengt. Vektor und ersetzte Argumente liegen in einem
+ * Block, ein free() gibt alles frei.
+ */
+static char** makeArgv(prog_args* tmpl, char* item, int* argc) {
+	size_t itemLen = strlen(item);
+	size_t size = (tmpl->argc + 2) * sizeof(char*);
+	int i, n, replaced = 0;
+	char** argv;
+	char* pos;
+
+	for (i = 0; i < tmpl->argc; i++) {
+		n = countBraces(tmpl->argv[i]);
+		if (n > 0)
+			size += strlen(tmpl->argv[i]) + n * itemLen - 2 * n + 1;
+	}
+	argv = malloc(size);
+	if (argv == NULL)
+		return NULL;
+	pos = (char*) (argv + tmpl->argc + 2);	// Platz fuer die Zeichenketten
+	for (i = 0; i < tmpl->argc; i++) {
+		char* arg = tmpl->argv[i];
+		char* brace = strstr(arg, "{}");
+		if (brace == NULL) {
+			argv[i] = arg;
+			continue;
+		}
+		argv[i] = pos;
+		do {
+			memcpy(pos, arg, brace - arg);
+			pos += brace - arg;
+			memcpy(pos, item, itemLen);
+			pos += itemLen;
+			arg = brace + 2;
+		} while ((brace = strstr(arg, "{}")) != NULL);
+		pos = stpcpy(pos, arg) + 1;
+		replaced = 1;
+	}
+	if (!replaced)
+		argv[i++] = item;
+	argv[i] = NULL;
+	*argc = i;
+	return argv;
+}
+
+/*
+ * Schreibt alles in fd (write() kann weniger schreiben)
+ */
+static void writeAll(int fd, char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+/*
+ * Startet den Befehl fuer ein item, stdout geht in eine Pipe
+ * (SIGCHLD ist blockiert)
+ */
+static void startTask(task* t, prog_args* tmpl, char* item) {
+	int fds[2], error = 0;
+
+	t->prog = *tmpl;
+	t->prog.background = 0;
+	t->prog.output = NULL;
+	t->prog.next = NULL;
+	t->prog.argv = makeArgv(tmpl, item, &t->prog.argc);
+	t->j = NULL;
+	t->fd = -1;
+	t->done = 1;
+	t->status = 127;
+
+	if (t->prog.argv == NULL || pipe2(fds, O_CLOEXEC) < 0) {
+		perror("parallel");
+		return;
+	}
+	/*
+	 * Ohne eigene Prozessgruppe: die Befehle laufen im Vordergrund der
+	 * Shell und bekommen Strg+C wie die Shell selbst
+	 */
+	t->j = startPipe(&t->prog, fds[1], 0, NULL, &error);
+	close(fds[1]);
+	if (t->j == NULL) {
+		close(fds[0]);
+		return;
+	}
+	t->fd = fds[0];
+	t->done = 0;
+}
+
+/*
+ * Liest die verfuegbare Ausgabe eines Befehls; bei EOF wird fd -1
+ */
+static void readTask(task* t) {
+	if (t->size - t->len < READ_SIZE) {
+		size_t size = t->size ? t->size * 2 : READ_SIZE * 2;
+		char* out = realloc(t->out, size);
+		if (out == NULL) {
+			perror("parallel");
+			close(t->fd);				// Rest der Ausgabe geht verloren
+			t->fd = -1;
+			return;
+		}
+		t->out = out;
+		t->size = size;
+	}
+	ssize_t n = read(t->fd, t->out + t->len, t->size - t->len);
+	if (n > 0)
+		t->len += n;
+	else if (n == 0 || errno != EINTR) {
+		close(t->fd);
+		t->fd = -1;
+	}
+}
+
+int executeParallel(parallel_args* par) {
+	int max = par->jobs;
+	int count = par->count;
+	int next = 0;			// naechstes zu startendes item
+	int printed = 0;		// mit -k: naechstes auszugebendes item
+	int running = 0;		// gestartete, noch nicht fertige Befehle
+	int failed = 0;
+	int outfd = STDOUT_FILENO;
+	int i;
+	sigset_t old, suspend;
+
+	if (max <= 0)
+		max = sysconf(_SC_NPROCESSORS_ONLN);
+	if (max <= 0)
+		max = 1;
+	if (count == 0)
+		return 0;
+
+	if (par->prog.output != NULL) {		// gesammelte Ausgabe in eine Datei
+		outfd = open(par->prog.output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+				0666);
+		if (outfd < 0) {
+			perror(par->prog.output);
+			return count;
+		}
+	}
+
+	task* tasks = calloc(count, sizeof(task));
+	struct pollfd* fds = malloc(max * sizeof(struct pollfd));
+	int* owner = malloc(max * sizeof(int));
+	if (tasks == NULL || fds == NULL || owner == NULL) {
+		perror("parallel");
+		free(tasks);
+		free(fds);
+		free(owner);
+		if (outfd != STDOUT_FILENO)
+			close(outfd);
+		return count;
+	}
+
+	fflush(NULL);
+	blockChild(&old);				// SIGCHLD nur waehrend ppoll() zulassen
+	suspend = old;
+	sigdelset(&suspend, SIGCHLD);
+
+	while (next < count || running > 0) {
+		// freie Plaetze auffuellen
+		while (running < max && next < count) {
+			startTask(&tasks[next], &par->prog, par->items[next]);
+			if (!tasks[next].done)
+				running++;
+			next++;
+		}
+
+		// auf Ausgaben oder SIGCHLD warten
+		int nfds = 0;
+		for (i = printed; i < next; i++) {
+			if (tasks[i].fd >= 0 && nfds < max) {
+				fds[nfds].fd = tasks[i].fd;
+				fds[nfds].events = POLLIN;
+				owner[nfds++] = i;
+			}
+		}
+		if (running > 0 && ppoll(fds, nfds, NULL, &suspend) > 0) {
+			for (i = 0; i < nfds; i++)
+				if (fds[i].revents)
+					readTask(&tasks[owner[i]]);
+		}
+
+		// fertige Befehle abschliessen
+		for (i = printed; i < next; i++) {
+			task* t = &tasks[i];
+			if (t->done || t->fd >= 0 || t->j->state != JOB_DONE)
+				continue;
+			t->status = WIFSIGNALED(t->j->status) ? 128 + WTERMSIG(t->j->status)
+					: WEXITSTATUS(t->j->status);
+			removeJob(t->j);
+			t->j = NULL;
+			t->done = 1;
+			running--;
+			if (!par->keep) {		// ungeordnet: sofort ausgeben
+				writeAll(outfd, t->out, t->len);
+				free(t->out);
+				t->out = NULL;
+			}
+		}
+
+		// geordnet: alle fertigen am Anfang ausgeben
+		while (printed < next && tasks[printed].done) {
+			task* t = &tasks[printed++];
+			if (t->out != NULL) {
+				writeAll(outfd, t->out, t->len);
+				free(t->out);
+			}
+			free(t->prog.argv);		// samt ersetzter Argumente
+			if (t->status != 0)
+				failed++;
+		}
+	}
+
+	unblockChild(&old);
+	if (outfd != STDOUT_FILENO)
+		close(outfd);
+	free(tasks);
+	free(fds);
+	free(owner);
+	return failed;
+}
@@ -13,15 +13,20 @@
  */
 
 //#include <malloc.h>   /* dynamic memory management                       */
-#include <setjmp.h>   /* longjumps to simplify error handling            */
 #include <stdbool.h>  /* constants                                       */
+#include <stddef.h>   /* offsetof                                        */
 #include <stdio.h>    /* I/O                                             */
 #include <stdlib.h>   /* standard c functions                            */
 #include <string.h>   /* string manipulations                            */
+#include <time.h>     /* clock for stress tests                          */
+#include <stdint.h>   /* uintptr_t                                       */
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h> /* vectorized scanning of identifiers             */
+#endif
 
 #include "Parser.h"
 
-#define MAX_LINE_LENGTH (2048)  /* maximum length of a command with args */
+#define NEW_BUFFER_LENGTH (256) /* initial size of token/variable buffers */
 #define NEW_ARGV_LENGTH (10)    /* initial size of the arg vector        */
 
 
@@ -71,126 +76,447 @@ enum token_kind
 typedef struct token
 {
 	enum token_kind kind;
-	char arg[MAX_LINE_LENGTH];
+	char* arg;                     /* text (slice of stream or argbuf)   */
+	size_t len;                    /* length of text                     */
 } token;
 
-/* variable buffer                                                       */
+/* growable buffer for rewritten identifiers and variable names          */
 typedef struct buffer
 {
-	char var[MAX_LINE_LENGTH];
+	char* data;                    /* buffer content                     */
+	size_t size;                   /* allocated bytes                    */
 } buffer;
 
 
-/* internal global state ----------------------------------------------- */
+/* character classes used by the scanner                                 */
+enum char_class
+{
+	C_END = 1,                     /* ends an identifier                 */
+	C_REWRITE = 2,                 /* quote, escape, or variable in ide  */
+	C_VAR_END = 4                  /* ends a variable name               */
+};
+
+static const unsigned char char_class[256] =
+{
+	['\0'] = C_END | C_VAR_END,
+	[' ']  = C_END | C_VAR_END,
+	['\t'] = C_END | C_VAR_END,
+	['\n'] = C_END | C_VAR_END,
+	['&']  = C_END | C_VAR_END,
+	['>']  = C_END | C_VAR_END,
+	['<']  = C_END | C_VAR_END,
+	['|']  = C_END | C_VAR_END,
+	[';']  = C_END | C_VAR_END,
+	['#']  = C_END | C_VAR_END,
+	['\''] = C_REWRITE | C_VAR_END,
+	['\\'] = C_REWRITE | C_VAR_END,
+	['$']  = C_REWRITE | C_VAR_END,
+	['{']  = C_VAR_END,
+	['}']  = C_VAR_END
+};
+
+#define CLASS(c) (char_class[(unsigned char)(c)])
+#define IS_PLAIN(c) (!(CLASS(c) & (C_END|C_REWRITE)))
+
+
+/* memory arena -------------------------------------------------------- */
 /* --------------------------------------------------------------------- */
 
-static cmds* root;       /* root pointer of command list                 */
-static int line;         /* current line scanned and parsed              */
-static int col;          /* current column scanned and parsed            */
+/* All memory of one parse result (commands, argument vectors, strings)  */
+/* is bump-allocated from a list of chunks. parser_free() hands the whole */
+/* list back at once, and the chunks are kept for the next parse.        */
+
+#define ARENA_CHUNK_SIZE (4096)        /* size of the first chunk        */
+#define ARENA_KEEP (1024*1024)         /* bytes kept for reuse at most   */
+#define ARENA_ALIGN (16)               /* alignment of allocations       */
+
+typedef struct chunk
+{
+	struct chunk* next;                /* next (older) chunk             */
+	size_t size;                       /* usable bytes after the header  */
+	size_t used;                       /* bytes handed out so far        */
+} chunk;
+
+#define ARENA_ROUND(n) (((n)+ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1))
+#define CHUNK_HEADER ARENA_ROUND(sizeof(chunk))
+#define CHUNK_DATA(c) ((char*)(c)+CHUNK_HEADER)
+
+/* the first command of a list also knows the arena of the whole list    */
+typedef struct root_cmd
+{
+	chunk* arena;                      /* all chunks of this parse       */
+	cmds cmd;                          /* first command of the list      */
+} root_cmd;
 
-static char* stream;     /* the stream to parse                          */
-static token lookahead;  /* last parsed token                            */
-static buffer varbuf;    /* buffer used for variable substitutions       */
-static int arg_pos;      /* position in argument buffer                  */
-static int var_pos;      /* position in variable buffer                  */
+/* Released chunks are kept per thread, so results may be freed on      */
+/* another thread than the one that parsed them.                         */
+static __thread chunk* spare;      /* released chunks waiting for reuse  */
+static __thread size_t spare_size; /* bytes held in spare                */
+static __thread parser_counters counters; /* statistics of this thread   */
 
 
-/* freeing memory ------------------------------------------------------ */
+/* parser context ------------------------------------------------------ */
 /* --------------------------------------------------------------------- */
 
-static void argv_free(prog_args* prog)
+/* name of a substituted variable, allocated from the arena of the parse */
+typedef struct var_dep
 {
-	int i;
-	for (i=0; i<prog->argc; i++)
+	struct var_dep* next;
+	char name[];
+} var_dep;
+
+struct parser_ctx
+{
+	cmds* root;          /* root pointer of command list                 */
+	int line;            /* current line scanned and parsed              */
+	int col;             /* current column scanned and parsed            */
+
+	char* stream;        /* the stream to parse                          */
+	token lookahead;     /* last parsed token                            */
+	buffer argbuf;       /* buffer used for rewritten identifiers        */
+	buffer varbuf;       /* buffer used for variable substitutions       */
+	size_t arg_pos;      /* position in argument buffer                  */
+	size_t var_pos;      /* position in variable buffer                  */
+	int argv_size;       /* size of current argument vector              */
+
+	chunk* arena;        /* chunks of the parse in progress              */
+	void* arena_last;    /* last allocation (may grow in place)          */
+	var_dep* deps;       /* variables substituted by the parse           */
+
+	enum parser_errors status; /* parser status                          */
+	int error_line;      /* line number of error                         */
+	int error_column;    /* column number of error                       */
+
+	char* (*lookup)(const char* name); /* source of variable values      */
+};
+
+/* context used by parser_parse()                                        */
+static parser_ctx default_ctx = { .lookup = getenv };
+
+
+/* arena functions ----------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* returns chunks to the spare list or to the system                     */
+static void arena_release(chunk* c)
+{
+	chunk* next;
+	for (; c!=NULL; c=next)
+	{
+		next = c->next;
+		if (spare_size+c->size <= ARENA_KEEP)
+		{
+			c->used = 0;
+			c->next = spare;
+			spare = c;
+			spare_size += c->size;
+		}
+		else
+		{
+			free(c);
+		}
+	}
+}
+
+/* gets a chunk with at least size usable bytes                          */
+static chunk* arena_chunk(parser_ctx* ctx, size_t size)
+{
+	chunk** prev;
+	chunk* c;
+	/* reuse a spare chunk if one is large enough                        */
+	for (prev=&spare; *prev!=NULL; prev=&(*prev)->next)
 	{
-		free(prog->argv[i]);
+		if ((*prev)->size >= size)
+		{
+			c = *prev;
+			*prev = c->next;
+			spare_size -= c->size;
+			counters.reused++;
+			return c;
+		}
 	}
-	free(prog->argv);
-	prog->argv=NULL;
-	prog->argc=0;
+	/* grow geometrically so large inputs need few chunks                */
+	if (size < ARENA_CHUNK_SIZE) size = ARENA_CHUNK_SIZE;
+	if (ctx->arena!=NULL && size < 2*ctx->arena->size)
+	{
+		size = 2*ctx->arena->size;
+	}
+	c = malloc(CHUNK_HEADER+size);
+	if (c==NULL) return NULL;
+	counters.chunks++;
+	c->size = size;
+	c->used = 0;
+	return c;
 }
 
-static void prog_free(prog_args* prog)
+/* allocates size bytes from the current arena, NULL if out of memory    */
+static void* arena_alloc(parser_ctx* ctx, size_t size)
 {
-	/* start freeing at end of the list                                  */
-	if (prog->next != NULL)
+	chunk* c = ctx->arena;
+	size = ARENA_ROUND(size);
+	if (c==NULL || c->size - c->used < size)
 	{
-		prog_free(prog->next);
+		c = arena_chunk(ctx, size);
+		if (c==NULL) return NULL;
+		c->next = ctx->arena;
+		ctx->arena = c;
 	}
-	/* free input, output files and itself                               */
-	argv_free(prog);
-	free(prog->input);
-	free(prog->output);
-	free(prog);
+	ctx->arena_last = CHUNK_DATA(c)+c->used;
+	c->used += size;
+	counters.allocs++;
+	counters.bytes += size;
+	return ctx->arena_last;
 }
 
-/* Frees a list of commands.                                             */
+/* resizes the last allocation in place if possible, else copies it     */
+static void* arena_realloc(parser_ctx* ctx, void* old, size_t old_size,
+                           size_t size)
+{
+	void* new;
+	chunk* c = ctx->arena;
+	size_t aligned = ARENA_ROUND(size);
+	if (old!=NULL && old==ctx->arena_last
+	    && (char*)old+aligned <= CHUNK_DATA(c)+c->size)
+	{
+		c->used = (char*)old+aligned-CHUNK_DATA(c);
+		return old;
+	}
+	new = arena_alloc(ctx, size);
+	if (new!=NULL && old!=NULL) memcpy(new, old, old_size);
+	return new;
+}
+
+/* copies len chars of a string into the current arena                  */
+static char* arena_strndup(parser_ctx* ctx, const char* s, size_t len)
+{
+	char* copy = arena_alloc(ctx, len+1);
+	if (copy!=NULL)
+	{
+		memcpy(copy, s, len);
+		copy[len] = '\0';
+	}
+	return copy;
+}
+
+/* Frees a list of commands. All commands, argument vectors and strings  */
+/* live in the arena of the list, so this is O(1) in the list length.    */
 void parser_free(cmds* cmd)
 {
-	/* start freeing at end of list                                      */
+	root_cmd* root;
 	if (cmd==NULL)
 	{
 		return;
 	}
-	else
+	root = (root_cmd*)((char*)cmd - offsetof(root_cmd, cmd));
+	arena_release(root->arena);
+}
+
+/* forgets the argument vector of a program (used for builtins)          */
+static void argv_free(prog_args* prog)
+{
+	prog->argv=NULL;
+	prog->argc=0;
+}
+
+
+/* error handling ------------------------------------------------------ */
+/* --------------------------------------------------------------------- */
+
+/* Sets error code and position. Only the first error is kept; every     */
+/* function checks ctx->status after calls that may fail and returns.    */
+static void raise_error(parser_ctx* ctx, enum parser_errors code)
+{
+	if (ctx->status!=PARSER_OK)
 	{
-		parser_free(cmd->next);
+		return;
 	}
-	/* free each type separately                                         */
-	switch (cmd->kind)
+	ctx->status = code;
+	if (code>=PARSER_INVALID_STATE)
 	{
-	case EXIT :
-	case JOB :
-		break;
-	case CD :
-		free(cmd->cd.path);
-		break;
-	case ENV :
-		free(cmd->env.name);
-		free(cmd->env.value);
-		break;
-	case PROG : case PIPE :
-		if (cmd->prog.next != NULL)
+		ctx->error_line=ctx->line;
+		ctx->error_column=ctx->col;
+	}
+}
+
+
+/* scanner ------------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* returns the first char at or after p that is not a plain identifier */
+/* char; the terminating '\0' always stops the search                   */
+static inline char* skip_plain_scalar(char* p)
+{
+	while (IS_PLAIN(*p))
+	{
+		p++;
+	}
+	return p;
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+/* the same using SIMD: a block of 16 (SSE2) or 32 (AVX2) chars is      */
+/* compared with all special chars at once. Loads are aligned, so they  */
+/* never cross a page boundary behind the terminating '\0'.             */
+static const char special_chars[] = " \t\n&><|;#\'\\$";
+
+#ifdef __AVX2__
+#define SIMD_WIDTH 32
+typedef __m256i simd_block;
+#define SIMD_LOAD(p) _mm256_load_si256((const __m256i*)(p))
+#define SIMD_ZERO() _mm256_setzero_si256()
+#define SIMD_SET1(c) _mm256_set1_epi8(c)
+#define SIMD_CMPEQ(a,b) _mm256_cmpeq_epi8(a,b)
+#define SIMD_OR(a,b) _mm256_or_si256(a,b)
+#define SIMD_MASK(a) ((unsigned)_mm256_movemask_epi8(a))
+#else
+#define SIMD_WIDTH 16
+typedef __m128i simd_block;
+#define SIMD_LOAD(p) _mm_load_si128((const __m128i*)(p))
+#define SIMD_ZERO() _mm_setzero_si128()
+#define SIMD_SET1(c) _mm_set1_epi8(c)
+#define SIMD_CMPEQ(a,b) _mm_cmpeq_epi8(a,b)
+#define SIMD_OR(a,b) _mm_or_si128(a,b)
+#define SIMD_MASK(a) ((unsigned)_mm_movemask_epi8(a))
+#endif
+
+/* bit mask of the special chars (and '\0') in a block                  */
+__attribute__((no_sanitize_address))
+static inline unsigned special_mask(const char* block)
+{
+	unsigned i;
+	simd_block v = SIMD_LOAD(block);
+	simd_block m = SIMD_CMPEQ(v, SIMD_ZERO());
+	for (i=0; i<sizeof(special_chars)-1; i++)
+	{
+		m = SIMD_OR(m, SIMD_CMPEQ(v, SIMD_SET1(special_chars[i])));
+	}
+	return SIMD_MASK(m);
+}
+
+__attribute__((no_sanitize_address))
+static char* skip_plain(char* p)
+{
+	size_t offset = (uintptr_t)p % SIMD_WIDTH;
+	char* block = p-offset;
+	/* ignore chars in front of p in the first block                    */
+	unsigned mask = special_mask(block) >> offset;
+	if (mask!=0)
+	{
+		return p+__builtin_ctz(mask);
+	}
+	for (;;)
+	{
+		block += SIMD_WIDTH;
+		mask = special_mask(block);
+		if (mask!=0)
 		{
-			prog_free(cmd->prog.next);
-			argv_free(&(cmd->prog));
-			free(cmd->prog.input);
-			free(cmd->prog.output);
+			return block+__builtin_ctz(mask);
 		}
-		break;
 	}
-	/* finally free command item                                         */
-	free(cmd);
 }
+#else
+#define skip_plain skip_plain_scalar
+#endif
 
+/* makes room for at least needed bytes; buffers grow geometrically, so */
+/* appending is amortized O(1) and there is no fixed length limit       */
+static int buffer_reserve(parser_ctx* ctx, buffer* buf, size_t needed)
+{
+	size_t size = buf->size ? buf->size : NEW_BUFFER_LENGTH;
+	char* data;
+	if (needed<=buf->size)
+	{
+		return true;
+	}
+	while (size<needed)
+	{
+		size*=2;
+	}
+	counters.grows++;
+	data = realloc(buf->data, size);
+	if (data==NULL)
+	{
+		raise_error(ctx, PARSER_MALLOC);
+		return false;
+	}
+	buf->data=data;
+	buf->size=size;
+	return true;
+}
 
-/* error handling ------------------------------------------------------ */
-/* --------------------------------------------------------------------- */
+/* appends chars to the rewritten identifier                            */
+static void arg_append(parser_ctx* ctx, const char* chars, size_t len)
+{
+	if (!buffer_reserve(ctx, &ctx->argbuf, ctx->arg_pos+len+1)) return;
+	memcpy(ctx->argbuf.data+ctx->arg_pos, chars, len);
+	ctx->arg_pos+=len;
+}
 
-jmp_buf error_env;                  /* environment buffer for long jumps */
+/* appends one char to the rewritten identifier                         */
+static void arg_put(parser_ctx* ctx, char c)
+{
+	if (ctx->arg_pos+1>=ctx->argbuf.size
+	    && !buffer_reserve(ctx, &ctx->argbuf, ctx->arg_pos+2))
+	{
+		return;
+	}
+	ctx->argbuf.data[ctx->arg_pos++]=c;
+}
 
-/* Sets error code and message. Returns from the deepest recursion using */
-/* a long jump.                                                          */
-static void raise_error(enum parser_errors code)
+/* appends one char to the variable name                                */
+static void var_put(parser_ctx* ctx, char c)
 {
-	parser_status = code;
-	parser_message = messages[code];
-	if (code>=PARSER_INVALID_STATE)
+	if (ctx->var_pos+1>=ctx->varbuf.size
+	    && !buffer_reserve(ctx, &ctx->varbuf, ctx->var_pos+2))
 	{
-		error_line=line;
-		error_column=col;
+		return;
 	}
-	/* cleanup before returning                                          */
-	parser_free(root);
-	longjmp(error_env,1);
+	ctx->varbuf.data[ctx->var_pos++]=c;
 }
 
+/* remembers a substituted variable once per parse (for the parse cache) */
+static void record_var(parser_ctx* ctx, const char* name)
+{
+	var_dep* dep;
+	size_t len;
+	if (ctx->status!=PARSER_OK) return;
+	for (dep=ctx->deps; dep!=NULL; dep=dep->next)
+	{
+		if (!strcmp(dep->name, name)) return;
+	}
+	len = strlen(name);
+	dep = arena_alloc(ctx, sizeof(var_dep)+len+1);
+	if (dep==NULL)
+	{
+		raise_error(ctx, PARSER_MALLOC);
+		return;
+	}
+	memcpy(dep->name, name, len+1);
+	dep->next = ctx->deps;
+	ctx->deps = dep;
+}
 
-/* scanner ------------------------------------------------------------- */
-/* --------------------------------------------------------------------- */
+/* ends an identifier: either a slice of the input or the copy in argbuf*/
+static void end_ide(parser_ctx* ctx, char* slice)
+{
+	if (slice!=NULL)
+	{
+		ctx->lookahead.arg=slice;
+		ctx->lookahead.len=ctx->stream-slice;
+	}
+	else
+	{
+		arg_put(ctx, '\0');
+		ctx->lookahead.arg=ctx->argbuf.data;
+		ctx->lookahead.len=ctx->arg_pos-1;
+	}
+}
 
 /* read the next token from input stream                                */
-static void read()
+/* Identifiers without quotes, escapes, and variables are returned as a */
+/* slice of the input stream. Only tokens that have to be rewritten are */
+/* copied into the token buffer.                                        */
+static void read(parser_ctx* ctx)
 {
 	/* initialization                                                   */
 	int quote = false;      /* set when scanning a quotation 'quote'    */
@@ -199,55 +525,53 @@ static void read()
 	int ide = false;        /* set when scanning an identifier          */
 	int variable = false;   /* set when scanning a variable $name       */
 	int bracket = false;    /* set when scanning a variable ${name}     */
+	char* slice = NULL;     /* start of a not rewritten identifier      */
     /* argument and variable buffers                                    */
-	char* arg = lookahead.arg;
-	char* var = varbuf.var;
 	char* value = NULL;
-	arg_pos = 0;
-	var_pos = 0;
-	lookahead.kind=UNKNOWN;
+	ctx->arg_pos = 0;
+	ctx->var_pos = 0;
+	ctx->lookahead.kind=UNKNOWN;
+	ctx->lookahead.arg=NULL;
+	ctx->lookahead.len=0;
 
 	/* read chars from stream                                           */
-	for (; ; stream++, col++)
+	for (; ; ctx->stream++, ctx->col++)
 	{
-		/* check for overflow                                           */
-		if (arg_pos>=MAX_LINE_LENGTH-1 || var_pos>=MAX_LINE_LENGTH-1)
+		/* stop on errors (out of memory in a buffer)                   */
+		if (ctx->status!=PARSER_OK)
 		{
-			raise_error(PARSER_OVERFLOW);
+			return;
 		}
 		/* gobble comments                                              */
 		if (comment)
 		{
-			if(*stream=='\n' || *stream=='\0')
+			if(*ctx->stream=='\n' || *ctx->stream=='\0')
 			{
-				*arg = '\0';
 				return;
 			}
-			*arg++=*stream;
-			arg_pos++;
 			continue;
 		}
 		/* gobble quotations                                            */
 		if (quote)
 		{	/* check for EOF                                            */
-			if (*stream=='\0')
+			if (*ctx->stream=='\0')
 			{
-				raise_error(PARSER_UNEXPECTED_EOF);
+				raise_error(ctx, PARSER_UNEXPECTED_EOF);
+				return;
 			}
 			/* check for end of quotation                               */
-			if (*stream=='\'')
+			if (*ctx->stream=='\'')
 			{
 				quote = false;
 			}
 			/* still gobbling quotation                                 */
 			else
 			{
-				*arg++=*stream;
-				arg_pos++;
-				if(*stream=='\n')
+				arg_put(ctx, *ctx->stream);
+				if(*ctx->stream=='\n')
 				{
-					col=0;
-					line++;
+					ctx->col=0;
+					ctx->line++;
 				}
 			}
 			continue;
@@ -255,17 +579,17 @@ static void read()
 		/* gobble escaped char                                          */
 		if (backspace)
 		{	/* check for EOF                                            */
-			if (*stream=='\0')
+			if (*ctx->stream=='\0')
 			{
-				raise_error(PARSER_UNEXPECTED_EOF);
+				raise_error(ctx, PARSER_UNEXPECTED_EOF);
+				return;
 			}
-			*arg++=*stream;
-			arg_pos++;
+			arg_put(ctx, *ctx->stream);
 			backspace = false;
-			if (*stream=='\n')
+			if (*ctx->stream=='\n')
 			{
-				col=0;
-				line++;
+				ctx->col=0;
+				ctx->line++;
 			}
 			continue;
 		}
@@ -273,199 +597,205 @@ static void read()
 		if (variable)
 		{
 			/* next char of variable name                               */
-			if (*stream!='\0' && strchr(" \t&><|\n;#\'\\${}",*stream)==NULL)
+			if (!(CLASS(*ctx->stream) & C_VAR_END))
 			{
-				*var++=*stream;
-				var_pos++;
+				var_put(ctx, *ctx->stream);
 				continue;
 			}
 			/* stop gobbling                                            */
 			if (bracket)
 			{
 				/* check for closing bracket                            */
-				if (*stream!='}')
+				if (*ctx->stream!='}')
 				{
-					raise_error(PARSER_BAD_SUBSTITUTION);
+					raise_error(ctx, PARSER_BAD_SUBSTITUTION);
+					return;
 				}
-				stream++;
-				col++;
+				ctx->stream++;
+				ctx->col++;
 			}
 			bracket=false;
 			variable=false;
-			*var='\0';
-			var=varbuf.var;
-			var_pos=0;
+			var_put(ctx, '\0');
+			ctx->var_pos=0;
 			/* and start substitution                                   */
-			value = getenv(var);
+			record_var(ctx, ctx->varbuf.data);
+			value = ctx->lookup(ctx->varbuf.data);
 			if (value!=NULL)
 			{
-				for (;*value!='\0';value++,arg++,arg_pos++)
-				{
-					if (arg_pos>=MAX_LINE_LENGTH-1)
-					{
-						raise_error(PARSER_OVERFLOW);
-
-					}
-					*arg=*value;
-				}
+				arg_append(ctx, value, strlen(value));
 			}
 		}
 		/* gobble identifier                                            */
 		if (ide)
 		{
+			/* skip a run of plain chars at once                        */
+			if (IS_PLAIN(*ctx->stream))
+			{
+				char* end = skip_plain(ctx->stream);
+				size_t run = end-ctx->stream;
+				/* copy it if the identifier is rewritten anyway        */
+				if (slice==NULL)
+				{
+					arg_append(ctx, ctx->stream, run);
+				}
+				ctx->stream=end;
+				ctx->col+=run;
+			}
 			/* stop gobbling                                            */
-			if (*stream=='\0' || strchr(" \t&><|\n;#",*stream)!=NULL)
+			if (CLASS(*ctx->stream) & C_END)
 			{
-				*arg='\0';
+				end_ide(ctx, slice);
 				return;
 			}
-			/* next char of identifier                                  */
-			if (strchr("\'\\$",*stream)==NULL)
+			/* quotes, escapes, and variables rewrite the identifier,   */
+			/* so the slice read so far is copied into the buffer       */
+			if (slice!=NULL)
 			{
-				*arg++=*stream;
-				arg_pos++;
-				continue;
+				arg_append(ctx, slice, ctx->stream-slice);
+				slice=NULL;
 			}
 			/* fall through for quotes, escapes, and variables          */
 		}
 
 		/* analyze next char in stream                                  */
-		switch (*stream)
+		switch (*ctx->stream)
 		{
 		/* EOF reached                                                  */
 		case '\0' :
-			*arg='\0';
-			lookahead.kind=END;
+			ctx->lookahead.kind=END;
 			return;
 		/* white spaces are skipped at the beginning                                     */
 		case ' ' : 	case '\t':
 			continue;
 		/* ampersand token                                              */
 		case '&':
-			*arg='\0';
-			lookahead.kind=AMP;
-			stream++;
-			col++;
+			ctx->lookahead.kind=AMP;
+			ctx->stream++;
+			ctx->col++;
 			return;
 		/* redirections                                                 */
 		case '>':
-			*arg='\0';
-			lookahead.kind=OUT;
-			stream++;
-			col++;
+			ctx->lookahead.kind=OUT;
+			ctx->stream++;
+			ctx->col++;
 			return;
 		case '<':
-			*arg='\0';
-			lookahead.kind=IN;
-			stream++;
-			col++;
+			ctx->lookahead.kind=IN;
+			ctx->stream++;
+			ctx->col++;
 			return;
 		/* pipe token                                                   */
 		case '|':
-			*arg='\0';
-			lookahead.kind=STROKE;
-			stream++;
-			col++;
+			ctx->lookahead.kind=STROKE;
+			ctx->stream++;
+			ctx->col++;
 			return;
 		/* new line or separator token                                  */
 		case '\n':
-			line++;
-			col=0;
-			*arg='\0';
-			lookahead.kind=SEP;
-			stream++;
+			ctx->line++;
+			ctx->col=0;
+			ctx->lookahead.kind=SEP;
+			ctx->stream++;
 			return;
 	    /* separator token                                              */
 		case ';':
-			*arg='\0';
-			lookahead.kind=SEP;
-			stream++;
-			col++;
+			ctx->lookahead.kind=SEP;
+			ctx->stream++;
+			ctx->col++;
 			return;
 		/* comment token                                                */
 		case '#':
 			comment=true;
-			lookahead.kind=REM;
+			ctx->lookahead.kind=REM;
 			continue;
 		/* quotations                                                   */
 		case '\'':
 			quote = true;
-			lookahead.kind=IDE;
+			ctx->lookahead.kind=IDE;
 			ide = true;
 			continue;
 		/* escaped chars                                                */
 		case '\\':
 			backspace=true;
-			lookahead.kind=IDE;
+			ctx->lookahead.kind=IDE;
 			ide=true;
 			continue;
 		/* variables                                                    */
 		case '$':
 			variable=true;
-			lookahead.kind=IDE;
+			ctx->lookahead.kind=IDE;
 			ide = true;
-			if ( *(stream+1) == '{')
+			if ( *(ctx->stream+1) == '{')
 			{
 				bracket=true;
-				stream++;
-				col++;
+				ctx->stream++;
+				ctx->col++;
 			}
 			continue;
-		/* finally a regular identifier                                 */
+		/* finally a regular identifier, read as slice of the stream    */
 		default:
-			lookahead.kind=IDE;
+			ctx->lookahead.kind=IDE;
 			ide = true;
-			*arg++=*stream;
-			arg_pos++;
+			slice = ctx->stream;
 		}
 	}
 }
 
 /* scan the next token from input stream.                               */
-static void scan()
+static void scan(parser_ctx* ctx)
 {
 	/* simply ignore comments                                           */
 	do
 	{
-		read();
+		read(ctx);
 	}
-	while (lookahead.kind==REM);
+	while (ctx->lookahead.kind==REM && ctx->status==PARSER_OK);
 }
 
 
 /* allocating memory --------------------------------------------------- */
 /* --------------------------------------------------------------------- */
 
-static int argv_size;                 /* size of current argument vector */
-
-static void argv_new(prog_args* prog)
+static void argv_new(parser_ctx* ctx, prog_args* prog)
 {
 	char** argv = NULL;
 	/* initialize prog                                                   */
 	prog->input=prog->output=NULL;
 	prog->next = NULL;
 	prog->background = false;
+	prog->timed = false;
+	prog->builtin = EXTERNAL;
 	prog->argc = 0;
 	prog->argv = NULL;
 	/* create argument vector                                            */
-	argv_size = NEW_ARGV_LENGTH;
-	argv = malloc(NEW_ARGV_LENGTH*sizeof(char *));
-	if (argv==NULL) raise_error(PARSER_MALLOC);
+	ctx->argv_size = NEW_ARGV_LENGTH;
+	argv = arena_alloc(ctx, NEW_ARGV_LENGTH*sizeof(char *));
+	if (argv==NULL)
+	{
+		raise_error(ctx, PARSER_MALLOC);
+		return;
+	}
 	argv[0]=NULL;
 	prog->argv=argv;
 	return;
 }
 
-static void argv_add(prog_args* prog, char* arg)
+static void argv_add(parser_ctx* ctx, prog_args* prog, char* arg)
 {
 	char** argv = prog->argv;
 	int argc = prog->argc;
 	/* increase vector size                                              */
-	if (argc+1>=argv_size)
+	if (argc+1>=ctx->argv_size)
 	{
-		argv_size+=NEW_ARGV_LENGTH;
-		argv = realloc(argv, argv_size*sizeof(char *));
-		if (argv==NULL) raise_error(PARSER_MALLOC);
+		argv = arena_realloc(ctx, argv, ctx->argv_size*sizeof(char *),
+		                     2*ctx->argv_size*sizeof(char *));
+		ctx->argv_size*=2;
+		if (argv==NULL)
+		{
+			raise_error(ctx, PARSER_MALLOC);
+			return;
+		}
 	}
 	/* add argument                                                      */
 	argv[argc++]=arg;
@@ -474,21 +804,40 @@ static void argv_add(prog_args* prog, char* arg)
 	prog->argc=argc;
 }
 
-static prog_args* prog_new()
+static prog_args* prog_new(parser_ctx* ctx)
 {
-	prog_args* prog = (prog_args*)malloc(sizeof(prog_args));
-	if (prog==NULL) raise_error(PARSER_MALLOC);
-	argv_new(prog);
+	prog_args* prog = (prog_args*)arena_alloc(ctx, sizeof(prog_args));
+	if (prog==NULL)
+	{
+		raise_error(ctx, PARSER_MALLOC);
+		return NULL;
+	}
+	argv_new(ctx, prog);
 	return prog;
 }
 
-static cmds* cmd_new()
+static cmds* cmd_new(parser_ctx* ctx)
 {
-	cmds* cmd = (cmds*)malloc(sizeof(cmds));
-	if (cmd==NULL) raise_error(PARSER_MALLOC);
+	cmds* cmd = NULL;
+	root_cmd* first = NULL;
+	/* the first command carries the arena of the whole list             */
+	if (ctx->root==NULL)
+	{
+		first = (root_cmd*)arena_alloc(ctx, sizeof(root_cmd));
+		if (first!=NULL) cmd = &first->cmd;
+	}
+	else
+	{
+		cmd = (cmds*)arena_alloc(ctx, sizeof(cmds));
+	}
+	if (cmd==NULL)
+	{
+		raise_error(ctx, PARSER_MALLOC);
+		return NULL;
+	}
 	cmd->kind=PROG;
 	cmd->next=NULL;
-	argv_new(&(cmd->prog));
+	argv_new(ctx, &(cmd->prog));
 	return cmd;
 }
 
@@ -496,281 +845,843 @@ static cmds* cmd_new()
 /* parser -------------------------------------------------------------- */
 /* --------------------------------------------------------------------- */
 
-/* returns a copy of the argument of the last parsed identifier          */
-static char* get_ide()
+/* returns a copy of the argument of the last parsed identifier; this is */
+/* the only copy of identifiers that were read as a slice of the input   */
+static char* get_ide(parser_ctx* ctx)
 {
 	char* ide = NULL;
-	if ( !(lookahead.kind==IDE) ) raise_error(PARSER_INVALID_STATE);
-	ide = strdup(lookahead.arg);
-	if (ide==NULL) raise_error(PARSER_MALLOC);
+	if ( !(ctx->lookahead.kind==IDE) )
+	{
+		raise_error(ctx, PARSER_INVALID_STATE);
+		return NULL;
+	}
+	ide = arena_strndup(ctx, ctx->lookahead.arg, ctx->lookahead.len);
+	if (ide==NULL) raise_error(ctx, PARSER_MALLOC);
 	return ide;
 }
 
 /* parses a redirection (PIPE token)                                     */
-static void parse_redirection(prog_args* prog)
+static void parse_redirection(parser_ctx* ctx, prog_args* prog)
 {
-	if (lookahead.kind==IN)
+	enum token_kind kind = ctx->lookahead.kind;
+	scan(ctx); /* skip '<' or '>' and scan identifier                    */
+	if (ctx->status!=PARSER_OK) return;
+	if (ctx->lookahead.kind!=IDE)
+	{
+		raise_error(ctx, PARSER_MISSING_FILE);
+		return;
+	}
+	if (kind==IN)
 	{
-		scan(); /* skip '<' and scan identifier                          */
-		if (lookahead.kind!=IDE) raise_error(PARSER_MISSING_FILE);
-		prog->input = get_ide();
+		prog->input = get_ide(ctx);
 	}
 	else
 	{
-		scan(); /* skip '>' and scan identifier                          */
-		if (lookahead.kind!=IDE) raise_error(PARSER_MISSING_FILE);
-		prog->output = get_ide();
+		prog->output = get_ide(ctx);
 	}
 }
 
 /* parse program arguments (builtins are also parsed this way first)      */
-static void parse_prog(cmds* cmd, prog_args* prog)
+static void parse_prog(parser_ctx* ctx, cmds* cmd, prog_args* prog)
 {
-	switch(lookahead.kind)
+	char* arg;
+	for (;;)
 	{
-	/* end of program arguments?                                         */
-	case AMP:
-		prog->background=true;
-	case SEP:
-	case END:
-	case STROKE:
-		return;
-	/* redirections?                                                     */
-	case OUT:
-	case IN:
-		parse_redirection(prog);
-		break;
-	/* argument?                                                         */
-	case IDE:
-		argv_add(prog,get_ide());
-		break;
-	default:
-		raise_error(PARSER_INVALID_STATE);
+		switch(ctx->lookahead.kind)
+		{
+		/* end of program arguments?                                     */
+		case AMP:
+			prog->background=true;
+		case SEP:
+		case END:
+		case STROKE:
+			return;
+		/* redirections?                                                 */
+		case OUT:
+		case IN:
+			parse_redirection(ctx, prog);
+			break;
+		/* argument?                                                     */
+		case IDE:
+			arg = get_ide(ctx);
+			if (arg!=NULL) argv_add(ctx, prog, arg);
+			break;
+		default:
+			raise_error(ctx, PARSER_INVALID_STATE);
+		}
+		if (ctx->status!=PARSER_OK) return;
+		/* parse next program argument                                   */
+		scan(ctx);
+		if (ctx->status!=PARSER_OK) return;
 	}
-	/* parse next program argument                                       */
-	scan();
-	parse_prog(cmd,prog);
 }
 
-static int get_int(char* number)
+static int get_int(parser_ctx* ctx, char* number)
 {
 	int value;
 	if(sscanf(number,"%i",&value)!=1 || value<0)
 	{
-		raise_error(PARSER_ILLEGAL_ARGUMENT);
+		raise_error(ctx, PARSER_ILLEGAL_ARGUMENT);
+		return -1;
 	}
 	return value;
 }
 
-/* distinguish builtin commands from parsed program arguments            */
-static void parse_cmd(cmds* cmd, prog_args* prog)
+/* parallel [-j n] [-k] command [args] ::: items; the template and the  */
+/* items stay in the argument vector, only ':::' is replaced by NULL     */
+static void parse_parallel(parser_ctx* ctx, cmds* cmd, prog_args* prog,
+                           int unused)
 {
-	char* path = NULL;  /* path for cd                                   */
-	char* name = NULL;  /* name of environment variable                  */
-	char* value = NULL; /* value of environment variable                 */
-	int id = -1;        /* job id                                        */
+	char** argv = prog->argv;
+	int jobs = 0;       /* maximum concurrent commands (0 = default)     */
+	int keep = false;   /* print output in order                          */
+	int i = 1;
+	int start, sep;
 
-	parse_prog(cmd, prog);
-	/* any command supplied?                                             */
-	if (prog->argc==0) raise_error(PARSER_MISSING_COMMAND);
-    /*  exit command?                                                    */
-	if (!strcmp(prog->argv[0],"exit"))
-	{
-		/* used in pipe?                                                 */
-		if (cmd->kind!=PROG) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* make exit command                                             */
-		argv_free(prog);
-		cmd->kind=EXIT;
-		return;
-	}
-	/* cd command                                                        */
-	if (!strcmp(prog->argv[0],"cd"))
+	/* options                                                           */
+	for (; i<prog->argc && argv[i][0]=='-'; i++)
 	{
-		/* used in pipe?                                                 */
-		if (cmd->kind==PIPE) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* make cd command                                               */
-		if (prog->argc>=2)
+		if (!strcmp(argv[i],"-k"))
 		{
-			path = strdup(prog->argv[1]);
-			if (path==NULL) raise_error(PARSER_MALLOC);
+			keep = true;
+		}
+		else if (!strcmp(argv[i],"-j") && i+1<prog->argc)
+		{
+			jobs = get_int(ctx, argv[++i]);
+			if (ctx->status!=PARSER_OK) return;
+			if (jobs==0)
+			{
+				raise_error(ctx, PARSER_ILLEGAL_ARGUMENT);
+				return;
+			}
+		}
+		else
+		{
+			raise_error(ctx, PARSER_ILLEGAL_ARGUMENT);
+			return;
 		}
-		argv_free(prog);
-		cmd->kind=CD;
-		cmd->cd.path=path;
-		return;
-	}
-	/* unset an environment variable                                     */
-	if (!strcmp(prog->argv[0],"unsetenv"))
-	{
-		/* used in pipe?                                                 */
-		if (cmd->kind==PIPE) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* enough args?                                                  */
-		if (prog->argc<2) raise_error(PARSER_MISSING_ARGUMENT);
-		/* make env command                                              */
-		name = strdup(prog->argv[1]);
-		if (name==NULL) raise_error(PARSER_MALLOC);
-		argv_free(prog);
-		cmd->kind=ENV;
-		cmd->env.name=name;
-		cmd->env.value=NULL;
-		return;
-	}
-	/* set an environment variable                                       */
-	if (!strcmp(prog->argv[0],"setenv"))
-	{
-		/* used in pipe?                                                 */
-		if (cmd->kind==PIPE) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* enough args?                                                  */
-		if (prog->argc<3) raise_error(PARSER_MISSING_ARGUMENT);
-		/* make env command                                              */
-		name = strdup(prog->argv[1]);
-		if (name==NULL) raise_error(PARSER_MALLOC);
-		value = strdup(prog->argv[2]);
-		if (value==NULL)
-		{
-			free(name);
-			raise_error(PARSER_MALLOC);
-		}
-		argv_free(prog);
-		cmd->kind=ENV;
-		cmd->env.name=name;
-		cmd->env.value=value;
-		return;
-	}
-	/* request job infos                                                 */
-	if (!strcmp(prog->argv[0],"jobs"))
-	{
-		/* used in pipe?                                                 */
-		if (cmd->kind==PIPE) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* make job command                                              */
-		if (prog->argc>=2) id=get_int(prog->argv[1]);
-		argv_free(prog);
-		cmd->kind=JOB;
-		cmd->job.kind=INFO;
-		cmd->job.id=id;
-		return;
 	}
-	/* continue a stopped job in background                              */
-	if (!strcmp(prog->argv[0],"bg"))
+	/* command template up to ':::'                                      */
+	start = i;
+	for (sep=start; sep<prog->argc && strcmp(argv[sep],":::"); sep++);
+	if (sep==prog->argc)
 	{
-		/* used in pipe?                                                 */
-		if (cmd->kind==PIPE) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* make job command                                              */
-		if (prog->argc>=2) id=get_int(prog->argv[1]);
-		argv_free(prog);
-		cmd->kind=JOB;
-		cmd->job.kind=BG;
-		cmd->job.id=id;
+		raise_error(ctx, PARSER_MISSING_ARGUMENT);
 		return;
 	}
-	/* continue a job in foreground                                      */
-	if (!strcmp(prog->argv[0],"fg"))
+	if (sep==start)
 	{
-		/* used in pipe?                                                 */
-		if (cmd->kind==PIPE) raise_error(PARSER_ILLEGAL_COMBINATION);
-		/* make job command                                              */
-		if (prog->argc>=2) id=get_int(prog->argv[1]);
-		argv_free(prog);
-		cmd->kind=JOB;
-		cmd->job.kind=FG;
-		cmd->job.id=id;
+		raise_error(ctx, PARSER_MISSING_COMMAND);
 		return;
 	}
-	/* check input for input redirection in pipe                         */
-	if (cmd->kind==PIPE && prog->input != NULL)
-	{
-		raise_error(PARSER_ILLEGAL_REDIRECTION);
-	}
+	/* make parallel command (prog is the first member of parallel)      */
+	argv[sep] = NULL;
+	cmd->kind=PARALLEL;
+	cmd->parallel.items=argv+sep+1;
+	cmd->parallel.count=prog->argc-sep-1;
+	cmd->parallel.jobs=jobs;
+	cmd->parallel.keep=keep;
+	prog->argv=argv+start;
+	prog->argc=sep-start;
 }
 
-static void parse_pipe(cmds* cmd, prog_args* prog)
+/* builtin commands; each one turns the parsed program into its command */
+/* and gets the argument from the registry below                         */
+
+static void make_exit(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
 {
-	prog_args* elem = NULL;
-	/* parse a command                                                   */
-	parse_cmd(cmd, prog);
-    /* not in pipe?                                                      */
-	if (lookahead.kind!=STROKE)
-	{
-		return;
-	}
-	/* builtin and starting pipe?                                        */
-	if( !(cmd->kind==PROG || cmd->kind==PIPE) )
-	{
-		raise_error(PARSER_ILLEGAL_COMBINATION);
-	}
-	/* in pipe                                                           */
-	cmd->kind=PIPE;
-	/* output redirection?                                               */
-	if (prog->output != NULL)
-	{
-		raise_error(PARSER_ILLEGAL_REDIRECTION);
-	}
-	/* skip pipe symbol and parse next command                           */
-	scan();
-	elem = prog_new();
-	prog->next=elem;
-	parse_pipe(cmd,elem);
+	argv_free(prog);
+	cmd->kind=EXIT;
 }
 
-/* start parsing the input line                                          */
-static void parse_input(cmds* cmd)
+static void make_cd(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
 {
-	cmds* elem;
-	/* examine first token                                               */
-	scan();
-	if (lookahead.kind==END)
-	{
-		return;
-	}
-
-	/* create new command element, add it to the list, and parse it      */
-	elem = cmd_new();
-	if (cmd==NULL)
-	{
-		root=cmd=elem;
-	}
-	else
-	{
-		cmd->next = elem;
-	}
-	parse_pipe(elem, &elem->prog);
-
-	/* parse next command from input                                     */
-	parse_input(elem);
+	char* path = prog->argc>=2 ? prog->argv[1] : NULL;
+	argv_free(prog);
+	cmd->kind=CD;
+	cmd->cd.path=path;
 }
 
-cmds* parser_parse(char *input)
+/* arg is true for setenv (with value) and false for unsetenv            */
+static void make_env(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
 {
-	/* initialize scanner and parser                                     */
-	stream = input;
-	line = col = error_line = error_column = 0;
-    root=NULL;
-    parser_status = PARSER_OK;
-    parser_message = messages[PARSER_OK];
-
-    /* save environment to return here in case of an error               */
-    if (setjmp(error_env))
-    {
-    	/* executed if error was raised                                  */
-    	return NULL;
-    }
-
-	/* parse input                                                       */
-	parse_input(root);
-	return root;
+	char* name = prog->argv[1];
+	char* value = NULL;
+	if (arg==ENV_SETENV || arg==ENV_SET) value=prog->argv[2];
+	argv_free(prog);
+	cmd->kind=ENV;
+	cmd->env.kind=arg;
+	cmd->env.name=name;
+	cmd->env.value=value;
 }
 
+/* arg is the kind of job control request                                */
+static void make_job(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
+{
+	int id = -1;
+	if (prog->argc>=2) id=get_int(ctx, prog->argv[1]);
+	argv_free(prog);
+	cmd->kind=JOB;
+	cmd->job.kind=arg;
+	cmd->job.id=id;
+}
 
-/* visualization ------------------------------------------------------- */
-/* --------------------------------------------------------------------- */
-
-static void print_prog(prog_args* prog)
+/* arg is true for rehash, hash needs -r to reset                        */
+static void make_hash(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
 {
-	int i;
-	if (prog->input!=NULL)
+	int reset = arg;
+	if (prog->argc>=2)
 	{
-		printf("<%s ", prog->input);
-	}
+		if (reset || strcmp(prog->argv[1],"-r"))
+		{
+			raise_error(ctx, PARSER_ILLEGAL_ARGUMENT);
+			return;
+		}
+		reset = true;
+	}
+	argv_free(prog);
+	cmd->kind=HASH;
+	cmd->hash.reset=reset;
+}
+
+static void make_source(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
+{
+	char* path = prog->argv[1];
+	argv_free(prog);
+	cmd->kind=SOURCE;
+	cmd->source.path=path;
+}
+
+static void make_stats(parser_ctx* ctx, cmds* cmd, prog_args* prog, int arg)
+{
+	enum stats_kind kind = STATS_SHOW;
+	if (prog->argc>=2)
+	{
+		if (!strcmp(prog->argv[1],"on")) kind=STATS_ON;
+		else if (!strcmp(prog->argv[1],"off")) kind=STATS_OFF;
+		else if (!strcmp(prog->argv[1],"reset")) kind=STATS_RESET;
+		else
+		{
+			raise_error(ctx, PARSER_ILLEGAL_ARGUMENT);
+			return;
+		}
+	}
+	argv_free(prog);
+	cmd->kind=STATS;
+	cmd->stats.kind=kind;
+}
+
+#define BUILTIN_IN_PIPE  (1)  /* may be a stage of a pipe                 */
+#define BUILTIN_PREFIX   (2)  /* prefix of the following program (time)  */
+#define BUILTIN_ANY_ARGS (-1) /* max_args without limit                  */
+
+typedef struct builtin_entry
+{
+	const char* name;  /* name of the builtin (NULL for free slots)      */
+	int min_args;      /* required arguments after the name              */
+	int max_args;      /* allowed arguments (BUILTIN_ANY_ARGS: no limit) */
+	int flags;         /* BUILTIN_IN_PIPE, BUILTIN_PREFIX                */
+	int arg;           /* passed to make, or the prog_builtin if no make */
+	void (*make)(parser_ctx*, cmds*, prog_args*, int);
+} builtin_entry;
+
+/* perfect hash of the builtin names: first two characters and length,   */
+/* chosen so that no two names share a slot; every program name costs   */
+/* one hash and at most one strcmp                                       */
+#define BUILTIN_SLOTS (64)
+#define BUILTIN_MAX_LENGTH (8)
+#define BUILTIN_KEY(c0, c1, len) (((unsigned char)(c0)              \
+                                   + 2*(unsigned char)(c1)          \
+                                   + 9*(len)) & (BUILTIN_SLOTS-1))
+#define BUILTIN_HASH(name, len) BUILTIN_KEY((name)[0], (name)[1], len)
+
+/* asserts that name (starting with c0 c1) belongs into slot; string     */
+/* subscripts are no constant expressions, so the characters are given   */
+#define BUILTIN_CHECK(slot, c0, c1, name)                                 \
+	_Static_assert(BUILTIN_KEY(c0, c1, sizeof(name)-1)==(slot)            \
+	               && sizeof(name)-1<=BUILTIN_MAX_LENGTH,                 \
+	               name " is not in its hash slot")
+
+/* slots are BUILTIN_HASH of the name (checked below and in the debug    */
+/* main); a slot used twice is an error                                  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+static const builtin_entry builtin_table[BUILTIN_SLOTS] =
+{
+	[ 2] = { "bg",       0, 1,                0,               BG,             make_job },
+	[ 6] = { "fg",       0, 1,                0,               FG,             make_job },
+	[ 7] = { "source",   1, 1,                0,               0,              make_source },
+	[ 8] = { "stats",    0, 1,                0,               0,              make_stats },
+	[10] = { "printf",   0, BUILTIN_ANY_ARGS, BUILTIN_IN_PIPE, BUILTIN_PRINTF, NULL },
+	[11] = { "export",   1, 1,                0,               ENV_EXPORT,     make_env },
+	[14] = { "hash",     0, 1,                0,               false,          make_hash },
+	[15] = { "echo",     0, BUILTIN_ANY_ARGS, BUILTIN_IN_PIPE, BUILTIN_ECHO,   NULL },
+	[21] = { "false",    0, BUILTIN_ANY_ARGS, BUILTIN_IN_PIPE, BUILTIN_FALSE,  NULL },
+	[24] = { "set",      2, 2,                0,               ENV_SET,        make_env },
+	[25] = { "unsetenv", 1, 1,                0,               ENV_UNSET,      make_env },
+	[34] = { "test",     0, BUILTIN_ANY_ARGS, BUILTIN_IN_PIPE, BUILTIN_TEST,   NULL },
+	[36] = { "[",        0, BUILTIN_ANY_ARGS, BUILTIN_IN_PIPE, BUILTIN_TEST,   NULL },
+	[42] = { "time",     0, BUILTIN_ANY_ARGS, BUILTIN_PREFIX,  0,              NULL },
+	[44] = { "jobs",     0, 1,                0,               INFO,           make_job },
+	[50] = { "rehash",   0, 0,                0,               true,           make_hash },
+	[51] = { "setenv",   2, 2,                0,               ENV_SETENV,     make_env },
+	[55] = { ".",        1, 1,                0,               0,              make_source },
+	[57] = { "exit",     0, 0,                0,               0,              make_exit },
+	[58] = { "parallel", 0, BUILTIN_ANY_ARGS, 0,               0,              parse_parallel },
+	[60] = { "true",     0, BUILTIN_ANY_ARGS, BUILTIN_IN_PIPE, BUILTIN_TRUE,   NULL },
+	[61] = { "cd",       0, 1,                0,               0,              make_cd }
+};
+#pragma GCC diagnostic pop
+
+BUILTIN_CHECK( 2, 'b', 'g', "bg");
+BUILTIN_CHECK( 6, 'f', 'g', "fg");
+BUILTIN_CHECK( 7, 's', 'o', "source");
+BUILTIN_CHECK( 8, 's', 't', "stats");
+BUILTIN_CHECK(10, 'p', 'r', "printf");
+BUILTIN_CHECK(11, 'e', 'x', "export");
+BUILTIN_CHECK(14, 'h', 'a', "hash");
+BUILTIN_CHECK(15, 'e', 'c', "echo");
+BUILTIN_CHECK(21, 'f', 'a', "false");
+BUILTIN_CHECK(24, 's', 'e', "set");
+BUILTIN_CHECK(25, 'u', 'n', "unsetenv");
+BUILTIN_CHECK(34, 't', 'e', "test");
+BUILTIN_CHECK(36, '[', '\0', "[");
+BUILTIN_CHECK(42, 't', 'i', "time");
+BUILTIN_CHECK(44, 'j', 'o', "jobs");
+BUILTIN_CHECK(50, 'r', 'e', "rehash");
+BUILTIN_CHECK(51, 's', 'e', "setenv");
+BUILTIN_CHECK(55, '.', '\0', ".");
+BUILTIN_CHECK(57, 'e', 'x', "exit");
+BUILTIN_CHECK(58, 'p', 'a', "parallel");
+BUILTIN_CHECK(60, 't', 'r', "true");
+BUILTIN_CHECK(61, 'c', 'd', "cd");
+
+/* returns the registry entry for name or NULL for external programs     */
+static const builtin_entry* find_builtin(const char* name)
+{
+	const builtin_entry* entry;
+	size_t len;
+	for (len=0; name[len]!='\0'; len++)
+	{
+		if (len==BUILTIN_MAX_LENGTH) return NULL;
+	}
+	/* the hash reads name[1]                                            */
+	if (len==0) return NULL;
+	entry = &builtin_table[BUILTIN_HASH(name, len)];
+	if (entry->name==NULL || strcmp(entry->name, name))
+	{
+		return NULL;
+	}
+	return entry;
+}
+
+/* distinguish builtin commands from parsed program arguments            */
+static void parse_cmd(parser_ctx* ctx, cmds* cmd, prog_args* prog)
+{
+	const builtin_entry* entry; /* builtin named by the first argument   */
+
+	parse_prog(ctx, cmd, prog);
+	if (ctx->status!=PARSER_OK) return;
+	/* any command supplied?                                             */
+	if (prog->argc==0)
+	{
+		raise_error(ctx, PARSER_MISSING_COMMAND);
+		return;
+	}
+	entry = find_builtin(prog->argv[0]);
+	/* time prefix: measure the following program or pipe; builtins that  */
+	/* change the shell (cd, setenv, jobs, ...) ignore it, the in-process */
+	/* programs echo, printf, test, true and false are measured in a      */
+	/* child process                                                      */
+	if (entry!=NULL && (entry->flags & BUILTIN_PREFIX))
+	{
+		/* only the whole pipe can be measured                           */
+		if (cmd->kind==PIPE)
+		{
+			raise_error(ctx, PARSER_ILLEGAL_COMBINATION);
+			return;
+		}
+		if (prog->argc<2)
+		{
+			raise_error(ctx, PARSER_MISSING_COMMAND);
+			return;
+		}
+		prog->timed=true;
+		prog->argv++;
+		prog->argc--;
+		/* 'time time' measures the program time                         */
+		entry = find_builtin(prog->argv[0]);
+		if (entry!=NULL && (entry->flags & BUILTIN_PREFIX))
+		{
+			entry = NULL;
+		}
+	}
+	if (entry!=NULL)
+	{
+		/* used in pipe?                                                 */
+		if (cmd->kind==PIPE && !(entry->flags & BUILTIN_IN_PIPE))
+		{
+			raise_error(ctx, PARSER_ILLEGAL_COMBINATION);
+			return;
+		}
+		/* enough args, and not too many?                                */
+		if (prog->argc-1<entry->min_args)
+		{
+			raise_error(ctx, PARSER_MISSING_ARGUMENT);
+			return;
+		}
+		if (entry->max_args!=BUILTIN_ANY_ARGS
+		    && prog->argc-1>entry->max_args)
+		{
+			raise_error(ctx, PARSER_ILLEGAL_ARGUMENT);
+			return;
+		}
+		/* make builtin command                                          */
+		if (entry->make!=NULL)
+		{
+			entry->make(ctx, cmd, prog, entry->arg);
+			return;
+		}
+		/* or run the program inside the shell                           */
+		prog->builtin=entry->arg;
+	}
+	/* check input for input redirection in pipe                         */
+	if (cmd->kind==PIPE && prog->input != NULL)
+	{
+		raise_error(ctx, PARSER_ILLEGAL_REDIRECTION);
+	}
+}
+
+/* parse the commands of a pipe; prog is always the last one            */
+static void parse_pipe(parser_ctx* ctx, cmds* cmd, prog_args* prog)
+{
+	prog_args* elem = NULL;
+	for (;;)
+	{
+		/* parse a command                                               */
+		parse_cmd(ctx, cmd, prog);
+		if (ctx->status!=PARSER_OK) return;
+		/* not (or no longer) in pipe?                                   */
+		if (ctx->lookahead.kind!=STROKE)
+		{
+			return;
+		}
+		/* builtin and starting pipe?                                    */
+		if( !(cmd->kind==PROG || cmd->kind==PIPE) )
+		{
+			raise_error(ctx, PARSER_ILLEGAL_COMBINATION);
+			return;
+		}
+		/* in pipe                                                       */
+		cmd->kind=PIPE;
+		/* output redirection?                                           */
+		if (prog->output != NULL)
+		{
+			raise_error(ctx, PARSER_ILLEGAL_REDIRECTION);
+			return;
+		}
+		/* skip pipe symbol and append next command                      */
+		scan(ctx);
+		if (ctx->status!=PARSER_OK) return;
+		elem = prog_new(ctx);
+		if (elem==NULL) return;
+		prog->next=elem;
+		prog=elem;
+	}
+}
+
+/* start parsing the input line; last is the tail of the command list,   */
+/* so the stack depth does not depend on the number of commands          */
+static void parse_input(parser_ctx* ctx)
+{
+	cmds* last = NULL;
+	cmds* elem;
+	for (;;)
+	{
+		/* examine first token of next command                           */
+		scan(ctx);
+		if (ctx->status!=PARSER_OK || ctx->lookahead.kind==END)
+		{
+			return;
+		}
+
+		/* create new command element, add it to the list, and parse it  */
+		elem = cmd_new(ctx);
+		if (elem==NULL) return;
+		if (last==NULL)
+		{
+			ctx->root=elem;
+		}
+		else
+		{
+			last->next = elem;
+		}
+		last = elem;
+		parse_pipe(ctx, elem, &elem->prog);
+		if (ctx->status!=PARSER_OK) return;
+	}
+}
+
+
+/* parser contexts ----------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+parser_ctx* parser_ctx_create(void)
+{
+	parser_ctx* ctx = (parser_ctx*)calloc(1, sizeof(parser_ctx));
+	if (ctx!=NULL)
+	{
+		ctx->lookup = getenv;
+	}
+	return ctx;
+}
+
+void parser_ctx_free(parser_ctx* ctx)
+{
+	if (ctx==NULL)
+	{
+		return;
+	}
+	free(ctx->argbuf.data);
+	free(ctx->varbuf.data);
+	free(ctx);
+}
+
+/* hands the arena over to the parsed list or releases it on errors     */
+static cmds* parse_finish(parser_ctx* ctx)
+{
+	/* cleanup in case of an error                                       */
+	if (ctx->status!=PARSER_OK)
+	{
+		ctx->root=NULL;
+	}
+	/* hand the arena over to the command list                           */
+	if (ctx->root==NULL)
+	{
+		arena_release(ctx->arena);
+	}
+	else
+	{
+		((root_cmd*)((char*)ctx->root - offsetof(root_cmd, cmd)))->arena =
+			ctx->arena;
+	}
+	ctx->arena=NULL;
+	return ctx->root;
+}
+
+void parser_ctx_begin(parser_ctx* ctx, char* input)
+{
+	/* initialize scanner and parser                                     */
+	ctx->stream = input;
+	ctx->line = ctx->col = ctx->error_line = ctx->error_column = 0;
+	ctx->root = NULL;
+	ctx->arena = NULL;
+	ctx->arena_last = NULL;
+	ctx->deps = NULL;
+	ctx->status = PARSER_OK;
+}
+
+cmds* parser_ctx_parse(parser_ctx* ctx, char* input)
+{
+	counters.parses++;
+	parser_ctx_begin(ctx, input);
+	parse_input(ctx);
+	return parse_finish(ctx);
+}
+
+cmds* parser_ctx_next(parser_ctx* ctx)
+{
+	/* an error ends the input                                           */
+	if (ctx->status!=PARSER_OK)
+	{
+		return NULL;
+	}
+	counters.parses++;
+	ctx->root = NULL;
+	ctx->deps = NULL;
+	/* skip empty lines, empty commands, and comments                    */
+	do
+	{
+		scan(ctx);
+	}
+	while (ctx->lookahead.kind==SEP && ctx->status==PARSER_OK);
+	if (ctx->status!=PARSER_OK || ctx->lookahead.kind==END)
+	{
+		return parse_finish(ctx);
+	}
+	/* parse exactly one command (a program, pipe, or builtin)           */
+	ctx->root = cmd_new(ctx);
+	if (ctx->root!=NULL)
+	{
+		parse_pipe(ctx, ctx->root, &ctx->root->prog);
+	}
+	return parse_finish(ctx);
+}
+
+void parser_ctx_set_lookup(parser_ctx* ctx, char* (*fn)(const char* name))
+{
+	ctx->lookup = fn!=NULL ? fn : getenv;
+}
+
+void parser_set_lookup(char* (*fn)(const char* name))
+{
+	parser_ctx_set_lookup(&default_ctx, fn);
+}
+
+void parser_counters_get(parser_counters* copy, int reset)
+{
+	*copy = counters;
+	if (reset)
+	{
+		memset(&counters, 0, sizeof(counters));
+	}
+}
+
+enum parser_errors parser_ctx_status(parser_ctx* ctx)
+{
+	return ctx->status;
+}
+
+char* parser_ctx_message(parser_ctx* ctx)
+{
+	return messages[ctx->status];
+}
+
+int parser_ctx_error_line(parser_ctx* ctx)
+{
+	return ctx->error_line;
+}
+
+int parser_ctx_error_column(parser_ctx* ctx)
+{
+	return ctx->error_column;
+}
+
+/* the classic interface uses a static context and global status         */
+cmds* parser_parse(char *input)
+{
+	cmds* cmd = parser_ctx_parse(&default_ctx, input);
+	parser_status = default_ctx.status;
+	parser_message = messages[default_ctx.status];
+	error_line = default_ctx.error_line;
+	error_column = default_ctx.error_column;
+	return cmd;
+}
+
+
+
+/* parse cache --------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* Interactive users repeat lines often (history, loops typed again and  */
+/* again). Results are immutable, so a list parsed once can be executed  */
+/* any number of times. An entry depends only on the input text and on   */
+/* the values of the variables it substituted; those are recorded while  */
+/* parsing and parser_cache_invalidate() drops every entry using them.   */
+
+#define CACHE_ENTRIES (64)             /* entries kept at most           */
+#define CACHE_BUCKETS (128)            /* hash buckets (power of two)    */
+#define CACHE_MAX_INPUT (4096)         /* longer inputs are not cached   */
+
+typedef struct cache_entry
+{
+	struct cache_entry* chain;         /* next entry in the same bucket  */
+	struct cache_entry* newer;         /* LRU list, most recent first    */
+	struct cache_entry* older;
+	unsigned long hash;                /* hash of text                   */
+	cmds* cmd;                         /* the parsed list                */
+	var_dep* deps;                     /* variables used (arena of cmd)  */
+	int pinned;                        /* handed out, not yet released   */
+	int stale;                         /* dropped while pinned           */
+	size_t len;                        /* length of text                 */
+	char text[];                       /* the input line                 */
+} cache_entry;
+
+static cache_entry* buckets[CACHE_BUCKETS];
+static cache_entry* newest;            /* head of the LRU list           */
+static cache_entry* oldest;            /* tail of the LRU list           */
+static cache_entry* dropped;           /* stale entries still pinned     */
+static int cached;                     /* entries in the LRU list        */
+
+/* FNV-1a hash of the input                                              */
+static unsigned long cache_hash(const char* text, size_t len)
+{
+	unsigned long hash = 2166136261UL;
+	size_t i;
+	for (i=0; i<len; i++)
+	{
+		hash = (hash ^ (unsigned char)text[i]) * 16777619UL;
+	}
+	return hash;
+}
+
+static void lru_unlink(cache_entry* entry)
+{
+	if (entry->newer!=NULL) entry->newer->older = entry->older;
+	else newest = entry->older;
+	if (entry->older!=NULL) entry->older->newer = entry->newer;
+	else oldest = entry->newer;
+}
+
+static void lru_push(cache_entry* entry)
+{
+	entry->newer = NULL;
+	entry->older = newest;
+	if (newest!=NULL) newest->newer = entry;
+	else oldest = entry;
+	newest = entry;
+}
+
+/* removes an entry from the cache; pinned entries are freed on release */
+static void cache_drop(cache_entry* entry)
+{
+	cache_entry** prev = &buckets[entry->hash & (CACHE_BUCKETS-1)];
+	while (*prev!=entry)
+	{
+		prev = &(*prev)->chain;
+	}
+	*prev = entry->chain;
+	lru_unlink(entry);
+	cached--;
+	if (entry->pinned)
+	{
+		entry->stale = true;
+		entry->chain = dropped;
+		dropped = entry;
+		return;
+	}
+	parser_free(entry->cmd);
+	free(entry);
+}
+
+cmds* parser_cache_parse(char* input)
+{
+	size_t len = strlen(input);
+	unsigned long hash = cache_hash(input, len);
+	cache_entry* entry;
+	cmds* cmd;
+	for (entry=buckets[hash & (CACHE_BUCKETS-1)]; entry!=NULL;
+	     entry=entry->chain)
+	{
+		if (entry->hash==hash && entry->len==len
+		    && !memcmp(entry->text, input, len))
+		{
+			counters.cache_hits++;
+			lru_unlink(entry);
+			lru_push(entry);
+			entry->pinned++;
+			parser_status = PARSER_OK;
+			parser_message = messages[PARSER_OK];
+			error_line = error_column = 0;
+			return entry->cmd;
+		}
+	}
+	counters.cache_misses++;
+	cmd = parser_parse(input);
+	/* errors and empty lines are not worth an entry                     */
+	if (cmd==NULL || len>CACHE_MAX_INPUT)
+	{
+		return cmd;
+	}
+	entry = malloc(sizeof(cache_entry)+len+1);
+	if (entry==NULL)
+	{
+		return cmd;
+	}
+	if (cached==CACHE_ENTRIES)
+	{
+		cache_drop(oldest);
+	}
+	memcpy(entry->text, input, len+1);
+	entry->len = len;
+	entry->hash = hash;
+	entry->cmd = cmd;
+	entry->deps = default_ctx.deps;
+	entry->pinned = 1;
+	entry->stale = false;
+	entry->chain = buckets[hash & (CACHE_BUCKETS-1)];
+	buckets[hash & (CACHE_BUCKETS-1)] = entry;
+	lru_push(entry);
+	cached++;
+	return cmd;
+}
+
+void parser_cache_release(cmds* cmd)
+{
+	cache_entry** prev;
+	cache_entry* entry;
+	if (cmd==NULL)
+	{
+		return;
+	}
+	for (entry=newest; entry!=NULL; entry=entry->older)
+	{
+		if (entry->cmd==cmd && entry->pinned)
+		{
+			entry->pinned--;
+			return;
+		}
+	}
+	for (prev=&dropped; *prev!=NULL; prev=&(*prev)->chain)
+	{
+		entry = *prev;
+		if (entry->cmd==cmd)
+		{
+			if (--entry->pinned==0)
+			{
+				*prev = entry->chain;
+				parser_free(entry->cmd);
+				free(entry);
+			}
+			return;
+		}
+	}
+	/* not cached at all                                                 */
+	parser_free(cmd);
+}
+
+void parser_cache_invalidate(const char* name)
+{
+	cache_entry* entry;
+	cache_entry* older;
+	var_dep* dep;
+	for (entry=newest; entry!=NULL; entry=older)
+	{
+		older = entry->older;
+		for (dep=entry->deps; dep!=NULL; dep=dep->next)
+		{
+			if (!strcmp(dep->name, name))
+			{
+				counters.cache_dropped++;
+				cache_drop(entry);
+				break;
+			}
+		}
+	}
+}
+
+void parser_cache_clear(void)
+{
+	while (oldest!=NULL)
+	{
+		cache_drop(oldest);
+	}
+}
+
+/* visualization ------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+static void print_prog(prog_args* prog)
+{
+	int i;
+	if (prog->builtin!=EXTERNAL)
+	{
+		printf("(builtin) ");
+	}
+	if (prog->input!=NULL)
+	{
+		printf("<%s ", prog->input);
+	}
 	for (i=0; i<prog->argc; i++)
 	{
 		printf("%s ",prog->argv[i]);
@@ -783,6 +1694,10 @@ static void print_prog(prog_args* prog)
 	{
 		printf("& ");
 	}
+	if (prog->timed)
+	{
+		printf("(timed) ");
+	}
 }
 
 static void print_pipe(cmds* cmd)
@@ -798,14 +1713,10 @@ static void print_pipe(cmds* cmd)
 	}
 }
 
-/* print/dump/visualize a command list                                   */
-void parser_print(cmds* cmd)
+/* print a single command                                               */
+static void print_cmd(cmds* cmd)
 {
-	if (cmd==NULL)
-	{
-		printf("NULL\n");
-		return;
-	}
+	int i;
 	switch (cmd->kind)
 	{
 	case EXIT:
@@ -821,13 +1732,20 @@ void parser_print(cmds* cmd)
 		print_pipe(cmd);
 		break;
 	case ENV:
-		if (cmd->env.value != NULL)
+		switch (cmd->env.kind)
 		{
+		case ENV_SETENV:
 			printf("SET %s=%s ",cmd->env.name,cmd->env.value);
-		}
-		else
-		{
+			break;
+		case ENV_UNSET:
 			printf("UNSET %s ",cmd->env.name);
+			break;
+		case ENV_SET:
+			printf("LOCAL %s=%s ",cmd->env.name,cmd->env.value);
+			break;
+		case ENV_EXPORT:
+			printf("EXPORT %s ",cmd->env.name);
+			break;
 		}
 		break;
 	case JOB:
@@ -839,16 +1757,49 @@ void parser_print(cmds* cmd)
 		}
 		if (cmd->job.id!=-1) printf("%d ",cmd->job.id);
 		break;
+	case HASH:
+		printf(cmd->hash.reset ? "REHASH " : "HASH ");
+		break;
+	case SOURCE:
+		printf("SOURCE %s ",cmd->source.path);
+		break;
+	case STATS:
+		switch (cmd->stats.kind)
+		{
+		case STATS_SHOW: printf("STATS "); break;
+		case STATS_ON: printf("STATS ON "); break;
+		case STATS_OFF: printf("STATS OFF "); break;
+		case STATS_RESET: printf("STATS RESET ");
+		}
+		break;
+	case PARALLEL:
+		printf("PARALLEL -j %d%s ", cmd->parallel.jobs,
+		       cmd->parallel.keep ? " -k" : "");
+		print_prog(&cmd->parallel.prog);
+		printf("::: ");
+		for (i=0; i<cmd->parallel.count; i++)
+		{
+			printf("%s ", cmd->parallel.items[i]);
+		}
+		break;
 	}
-	if (cmd->next!=NULL)
+}
+
+/* print/dump/visualize a command list                                   */
+void parser_print(cmds* cmd)
+{
+	if (cmd==NULL)
 	{
-		printf(";\n");
-		parser_print(cmd->next);
+		printf("NULL\n");
+		return;
 	}
-	else
+	for (; cmd->next!=NULL; cmd=cmd->next)
 	{
-		printf("\n");
+		print_cmd(cmd);
+		printf(";\n");
 	}
+	print_cmd(cmd);
+	printf("\n");
 }
 
 /* test the parser and visualize the results                             */
@@ -865,50 +1816,266 @@ void parser_test(char* input)
 }
 
 #ifdef PARSER_DEBUG
+#include "ParserCorpus.h"
+
+/* compares the vectorized identifier scanner with the scalar one for    */
+/* random input at every start position (and thus every alignment)       */
+static void test_skip_plain()
+{
+	char input[320];
+	int round, start, len, i;
+	int checks = 0, errors = 0;
+	srand(42);
+	for (round=0; round<2000; round++)
+	{
+		len = rand()%300;
+		for (i=0; i<len; i++)
+		{
+			/* mostly plain chars, now and then any other char          */
+			input[i] = rand()%4 ? 'a'+rand()%26 : 1+rand()%255;
+		}
+		input[len] = '\0';
+		for (start=0; start<=len; start++, checks++)
+		{
+			if (skip_plain(input+start)!=skip_plain_scalar(input+start))
+			{
+				errors++;
+			}
+		}
+	}
+	printf("skip_plain: %s (%d checks, %d errors)\n \n",
+	       errors ? "FAILED" : "ok", checks, errors);
+}
+
+/* parses a command with one huge token of size bytes in three flavors  */
+/* (plain slice, quoted, and substituted variable) and prints the time;  */
+/* parse time should grow linearly with the token size                   */
+static void stress_token(size_t size)
+{
+	char* input = malloc(size+16);
+	char* kinds[] = { "plain", "quoted", "variable" };
+	int kind;
+	cmds* cmd;
+	clock_t start;
+	double ms;
+	if (input==NULL) return;
+	for (kind=0; kind<3; kind++)
+	{
+		memset(input, 'x', size+16);
+		switch (kind)
+		{
+		case 0:
+			memcpy(input, "echo ", 5);
+			input[size+5] = '\0';
+			break;
+		case 1:
+			memcpy(input, "echo '", 6);
+			memcpy(input+size+6, "'", 2);
+			break;
+		case 2:
+			input[size] = '\0';
+			setenv("huge", input, true);
+			strcpy(input, "echo $huge");
+			break;
+		}
+		start = clock();
+		cmd = parser_parse(input);
+		ms = 1000.0*(clock()-start)/CLOCKS_PER_SEC;
+		printf("stress %-8s %5zu KB: %s, %7.2f ms, %8.1f MB/s\n",
+		       kinds[kind], size/1024,
+		       cmd!=NULL && strlen(cmd->prog.argv[1])==size ? "ok" : "FAILED",
+		       ms, ms>0 ? size/1024.0/1024.0/(ms/1000.0) : 0.0);
+		parser_free(cmd);
+	}
+	unsetenv("huge");
+	free(input);
+}
+
+/* parses n copies of a command (separated by ';') and prints the time; */
+/* with the iterative parser the time grows linearly and the stack depth */
+/* stays constant even for a million commands                            */
+static void stress_commands(const char* command, size_t n)
+{
+	size_t len = strlen(command);
+	char* input = malloc(n*(len+1)+1);
+	char* pos = input;
+	size_t i, count = 0;
+	cmds* cmd;
+	cmds* elem;
+	clock_t start;
+	double ms;
+	if (input==NULL) return;
+	for (i=0; i<n; i++)
+	{
+		memcpy(pos, command, len);
+		pos += len;
+		*pos++ = ';';
+	}
+	*pos = '\0';
+	start = clock();
+	cmd = parser_parse(input);
+	ms = 1000.0*(clock()-start)/CLOCKS_PER_SEC;
+	for (elem=cmd; elem!=NULL; elem=elem->next)
+	{
+		count++;
+	}
+	printf("stress %-20s %8zu cmds: %s, %8.2f ms, %6.2f Mcmds/s\n",
+	       command, n, count==n ? "ok" : "FAILED", ms,
+	       ms>0 ? n/1000.0/ms : 0.0);
+	parser_free(cmd);
+	free(input);
+}
+
+/* parses with two contexts in turn; the results and the status of one  */
+/* context must not be affected by the other one                         */
+static void test_contexts()
+{
+	parser_ctx* a = parser_ctx_create();
+	parser_ctx* b = parser_ctx_create();
+	cmds* first;
+	cmds* second;
+	int ok;
+	if (a==NULL || b==NULL) return;
+	first = parser_ctx_parse(a, "ls -l 'quoted arg' | sort >out");
+	second = parser_ctx_parse(b, "echo 'open quote");
+	ok = second==NULL
+	     && parser_ctx_status(b)==PARSER_UNEXPECTED_EOF
+	     && parser_ctx_status(a)==PARSER_OK;
+	parser_free(second);
+	second = parser_ctx_parse(b, "cd /tmp; exit");
+	ok = ok && first!=NULL && first->kind==PIPE
+	     && !strcmp(first->prog.argv[1], "-l")
+	     && !strcmp(first->prog.argv[2], "quoted arg")
+	     && !strcmp(first->prog.next->output, "out")
+	     && second!=NULL && second->kind==CD && second->next->kind==EXIT;
+	parser_free(first);
+	parser_free(second);
+	parser_ctx_free(a);
+	parser_ctx_free(b);
+	printf("contexts: %s\n \n", ok ? "ok" : "FAILED");
+}
+
+/* parses a script command by command and prints each command with its */
+/* line; parsing stops at the first error                                */
+static void test_next(char* input)
+{
+	parser_ctx* ctx = parser_ctx_create();
+	cmds* cmd;
+	if (ctx==NULL) return;
+	printf("script: %s\n", input);
+	parser_ctx_begin(ctx, input);
+	while ((cmd = parser_ctx_next(ctx)) != NULL)
+	{
+		printf("next:   ");
+		parser_print(cmd);
+		parser_free(cmd);
+	}
+	printf("status: %d %s (line %d)\n \n", parser_ctx_status(ctx),
+	       parser_ctx_message(ctx), parser_ctx_error_line(ctx));
+	parser_ctx_free(ctx);
+}
+
+/* every name of the builtin registry must sit in the slot of its hash   */
+static void test_builtin_table()
+{
+	size_t i, len, count = 0;
+	int ok = true;
+	for (i=0; i<BUILTIN_SLOTS; i++)
+	{
+		if (builtin_table[i].name==NULL) continue;
+		count++;
+		len = strlen(builtin_table[i].name);
+		ok = ok && len<=BUILTIN_MAX_LENGTH
+		     && BUILTIN_HASH(builtin_table[i].name, len)==i
+		     && find_builtin(builtin_table[i].name)==&builtin_table[i];
+	}
+	ok = ok && find_builtin("ls")==NULL && find_builtin("")==NULL
+	     && find_builtin("parallelx")==NULL && find_builtin("cdx")==NULL;
+	printf("builtin table (%zu builtins): %s\n \n", count,
+	       ok ? "ok" : "FAILED");
+}
+
+/* repeated lines come from the cache until one of their variables is   */
+/* changed; lists still in use survive invalidation and eviction         */
+static void test_cache()
+{
+	parser_counters c;
+	cmds* first;
+	cmds* second;
+	cmds* other;
+	char line[32];
+	int i, ok;
+	parser_counters_get(&c, true);
+	first = parser_cache_parse("echo $a x");
+	second = parser_cache_parse("echo $a x");
+	other = parser_cache_parse("ls -l");
+	ok = first!=NULL && first==second && other!=NULL
+	     && !strcmp(first->prog.argv[1], "var1");
+	parser_cache_release(second);
+	parser_cache_release(other);
+	/* first is still pinned and must stay valid                         */
+	setenv("a", "var9", true);
+	parser_cache_invalidate("a");
+	ok = ok && !strcmp(first->prog.argv[1], "var1");
+	parser_cache_release(first);
+	second = parser_cache_parse("echo $a x");
+	ok = ok && second!=NULL && !strcmp(second->prog.argv[1], "var9");
+	parser_cache_release(second);
+	ok = ok && parser_cache_parse("ls -l")==other;
+	parser_cache_release(other);
+	/* errors are not cached                                             */
+	ok = ok && parser_cache_parse("echo 'x")==NULL
+	     && parser_status==PARSER_UNEXPECTED_EOF
+	     && parser_cache_parse("echo 'x")==NULL;
+	/* eviction of the least recently used lines                         */
+	for (i=0; i<2*CACHE_ENTRIES; i++)
+	{
+		sprintf(line, "echo %d", i);
+		parser_cache_release(parser_cache_parse(line));
+	}
+	ok = ok && cached==CACHE_ENTRIES;
+	parser_counters_get(&c, true);
+	ok = ok && c.cache_hits==2 && c.cache_dropped==1
+	     && c.cache_misses==5+2*CACHE_ENTRIES;
+	parser_cache_clear();
+	setenv("a", "var1", true);
+	printf("cache: %s\n \n", ok && cached==0 ? "ok" : "FAILED");
+}
+
 /* main function for debug issuing a number of tests                     */
 int main()
 {
+	size_t i;
+
+	test_skip_plain();
+	test_contexts();
+	test_builtin_table();
+
 	setenv("a","var1",true);
 	setenv("b","var2",true);
 	setenv("c","var3",true);
+	test_cache();
+
+	for (i=0; i<PARSER_CORPUS_LENGTH; i++)
+	{
+		parser_test((char*)parser_corpus[i]);
+	}
+
+	test_next("#!/bin/shell\n\n# comment\nls -l | sort &\n\ncd /tmp; setenv a 1\n");
+	test_next("echo 'multi\nline'; exit\nnot reached");
+	test_next("ls\n\nls |\n");
+
+	stress_token(1024*1024);
+	stress_token(2*1024*1024);
+	stress_token(4*1024*1024);
+	stress_token(8*1024*1024);
 
-	parser_test("");
-	parser_test("exit");
-	parser_test("cd ..");
-	parser_test("cd exit");
-	parser_test("cd foo next arguments are ignored");
-	parser_test("ls -l");
-	parser_test("cat; ls foo");
-	parser_test("cat; ; ls foo");
-	parser_test("ls -l -a -r   \n   cd \n echo foobar");
-	parser_test(">file ls");
-	parser_test("> out <in cat & echo foo");
-	parser_test("missing file >& cd ..");
-	parser_test("missing file <; exit");
-	parser_test("ls <in -lisa | grep '.pdf' | sort >out");
-	parser_test("ls > foo | grep .pdf    | sort");
-	parser_test("ls | <foo grep .pdf |   sort");
-	parser_test("ls | grep .pdf >bar |   sort");
-	parser_test("cd .. | ls");
-	parser_test("ls | exit | sort");
-	parser_test("ls | sort | cd /bar/foo");
-	parser_test("# this is a comment");
-	parser_test("> out echo bla # this is a comment echo; $foo; 'open quote \n ls -l");
-	parser_test("echo '; >foo <bar exit cd & \n $a | &' & ls -lisa" );
-	parser_test("echo escaping \\\\ \\a \\< foo \\> bar \\; \\| \\$a \\& hello");
-	parser_test("open 'quotation\n is still open");
-	parser_test("open escaped char \\");
-	parser_test("setenv foo 'bar and barfoo' this is ignored up to here; exit");
-	parser_test("setenv foo");
-	parser_test("unsetenv foo and this is ignored up to here; exit");
-	parser_test("unsetenv");
-	parser_test("$a> $b& cd ..; exit");
-	parser_test("${here <foobar");
-	parser_test("echo alloneide'bla'blub\\#\\;$a${b}$c'yeah'");
-	parser_test("jobs 13 ignored; bg 1 ignored; fg 3 igno red; bg; fg");
-	parser_test("jobs foobar");
-	parser_test("bg -42");
-	parser_test("fg dunno");
+	stress_commands("true", 10000);
+	stress_commands("true", 100000);
+	stress_commands("true", 1000000);
+	stress_commands("ls -l <in | sort >out", 10000);
+	stress_commands("ls -l <in | sort >out", 100000);
+	stress_commands("ls -l <in | sort >out", 1000000);
 
 	return EXIT_SUCCESS;
 }
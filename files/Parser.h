@@ -10,8 +10,15 @@
  * -commands to be executed as foreground or background (&) jobs
  * -input (<) and output (>) redirections from/to a file
  * -commands assembled to pipes (|)
- * -the builtin commands exit, cd [path], jobs, fg [id], bg [id], and
- *  [un]setenv variable [value]
+ * -the builtin commands exit, cd [path], jobs, fg [id], bg [id],
+ *  [un]setenv variable [value], set variable value, export variable,
+ *  hash [-r] or rehash, and source file
+ * -the builtin parallel [-j n] [-k] command [args] ::: items
+ * -the prefix time for programs and pipes (time ls | sort); builtin
+ *  commands like cd ignore it, echo, printf, test, true, and false are
+ *  measured
+ * -the builtin stats [on|off|reset]
+ * -the programs echo, printf, test, [, true, and false run by the shell
  * -comments (#) that are ignored until end of line
  * -variable substitutions with $variable or ${variable}
  * -quotations with single quotation marks (') protecting enclosed content
@@ -58,10 +65,19 @@ typedef struct cd_args  /* arguments for builtin command 'cd'             */
 	char* path;         /* directory path (might be NULL if not given)    */
 } cd_args;
 
+enum env_kind           /* types of variable commands                     */
+{
+	ENV_SETENV,         /* setenv: set and export                         */
+	ENV_UNSET,          /* unsetenv: delete                               */
+	ENV_SET,            /* set: set, exported only if it was before       */
+	ENV_EXPORT          /* export: export a shell variable                */
+};
+
 typedef struct env_args /* arguments of builtin environment commands      */
-{                       /* [un]set variable [value]                       */
+{                       /* [un]setenv, set, export variable [value]       */
+	enum env_kind kind; /* kind of variable command (see above)           */
 	char* name;         /* environment variable to set/delete (not NULL)  */
-	char* value;        /* value to set (is NULL in unset command)        */
+	char* value;        /* value to set (NULL for unsetenv and export)    */
 } env_args;
 
 enum job_kind           /* types of job control commands                  */
@@ -78,22 +94,70 @@ typedef struct job_args /* arguments of builtin job control               */
 	env_args *foo;
 } job_args;
 
+typedef struct hash_args /* arguments of builtin 'hash [-r]' and 'rehash' */
+{
+	int reset;           /* forget all remembered paths when true         */
+} hash_args;
+
+typedef struct source_args  /* arguments of builtin 'source file'         */
+{
+	char* path;             /* script to read commands from (not NULL)    */
+} source_args;
+
+enum prog_builtin   /* programs run inside the shell instead of exec      */
+{
+	EXTERNAL,       /* no builtin, the program is started from PATH       */
+	BUILTIN_ECHO,   /* 'echo [-neE] args'                                 */
+	BUILTIN_PRINTF, /* 'printf format args'                               */
+	BUILTIN_TEST,   /* 'test expression' and '[ expression ]'             */
+	BUILTIN_TRUE,   /* 'true'                                             */
+	BUILTIN_FALSE   /* 'false'                                            */
+};
+
 typedef struct prog_args    /* arguments of an external command           */
 {                           /* program arg1 arg2 ...                      */
 	char* input;            /* input redirection from file (might be NULL)*/
 	char* output;           /* output redirection to file (might be NULL) */
 	int background;         /* execute in background when true            */
+	int timed;              /* 'time' prefix (only set for first in pipe) */
+	enum prog_builtin builtin; /* may run inside the shell (see above)    */
 	int argc;               /* elements in argument vector (>=1)          */
 	char** argv;            /* argument vector                            */
 	struct prog_args* next; /* next command when in pipe (NULL otherwise) */
 } prog_args;
 
+typedef struct parallel_args /* arguments of builtin 'parallel'           */
+{                       /* parallel [-j n] [-k] command [args] ::: items  */
+	prog_args prog;     /* command template ({} is replaced by an item)   */
+	int jobs;           /* maximum concurrent commands (0 if not given)   */
+	int keep;           /* print output in order of items when true       */
+	int count;          /* number of items                                */
+	char** items;       /* items after ':::' (NULL terminated)            */
+} parallel_args;
+
+enum stats_kind         /* types of stats commands                        */
+{
+	STATS_SHOW,         /* print histograms and counters                  */
+	STATS_ON,           /* start recording                                */
+	STATS_OFF,          /* stop recording                                 */
+	STATS_RESET         /* forget everything recorded so far              */
+};
+
+typedef struct stats_args /* arguments of builtin 'stats'                 */
+{
+	enum stats_kind kind; /* kind of stats request                        */
+} stats_args;
+
 enum cmd_kind  /* type of command (internal, external, or in a pipe)      */
 {
 	EXIT,      /* builtin 'exit'                                          */
 	CD,        /* builtin 'cd [path]'                                     */
 	ENV,       /* builtin '[un]set variable [value]'                      */
 	JOB,       /* builtin 'jobs [id]', 'bg [id], and fg [id]'             */
+	HASH,      /* builtin 'hash [-r]' and 'rehash'                        */
+	SOURCE,    /* builtin 'source file' and '. file'                      */
+	PARALLEL,  /* builtin 'parallel ... ::: items'                        */
+	STATS,     /* builtin 'stats [on|off|reset]'                          */
 	PROG,      /* external command/program                                */
 	PIPE       /* external commands in a pipe                             */
 };
@@ -106,7 +170,11 @@ typedef struct cmds     /* structure representing a list of parsed        */
 		cd_args  cd;    /* path for cd                                    */
 		env_args env;   /* variable name and value                        */
 		job_args job;   /* job id and request type                        */
+		hash_args hash; /* whether the command hash is reset              */
+		source_args source; /* script for source                          */
 		prog_args prog; /* program and its arguments (for PROG and PIPE)  */
+		parallel_args parallel; /* template and items for parallel        */
+		stats_args stats; /* request for stats                            */
 	};
 	struct cmds *next;  /* next command in list                           */
 } cmds;
@@ -129,15 +197,137 @@ extern cmds* parser_parse(char* input);
 
 /*
  * Frees a parsed command list if it is not longer needed by the shell. If
- * handle is NULL nothing happens.
+ * handle is NULL nothing happens. The handle must be the head of a list
+ * returned by parser_parse(); the whole list is released at once and its
+ * memory is reused by following calls of parser_parse(). Lists may be
+ * freed on any thread; freed memory is kept for reuse by that thread.
  */
 extern void parser_free(cmds* handle);
 
+/*
+ * Sets the function used by parser_parse() and parser_cache_parse() to
+ * look up $variable substitutions. It returns the value or NULL if the
+ * variable is not set. Default is getenv(). Other contexts are not
+ * affected, see parser_ctx_set_lookup().
+ */
+extern void parser_set_lookup(char* (*lookup)(const char* name));
+
+/**
+ * Parse cache.
+ */
+
+/*
+ * Same as parser_parse() but keeps the result in a small LRU cache keyed
+ * by the input text, so repeated lines are not scanned again. The list is
+ * shared with later calls and must not be changed; release it with
+ * parser_cache_release() instead of parser_free(). Lines with errors are
+ * not cached. The cache is not thread safe; it is meant for the shell's
+ * read-eval loop only.
+ */
+extern cmds* parser_cache_parse(char* input);
+
+/*
+ * Releases a list returned by parser_cache_parse(). The list stays in the
+ * cache unless it was dropped in the meantime.
+ */
+extern void parser_cache_release(cmds* handle);
+
+/*
+ * Drops every cached list that substituted the variable name. Has to be
+ * called whenever the value of a variable changes. Lists still in use
+ * are freed when they are released.
+ */
+extern void parser_cache_invalidate(const char* name);
+
+/*
+ * Drops all cached lists.
+ */
+extern void parser_cache_clear(void);
+
+/**
+ * Reentrant parser functions.
+ */
+
+/*
+ * A parser context holds the complete state of one parser: scanner
+ * position, token buffers, the arena of the parse in progress, and the
+ * status of the last parse. Contexts are independent of each other, so
+ * several threads may parse at the same time if each uses its own
+ * context. parser_parse() above uses a context of its own.
+ */
+typedef struct parser_ctx parser_ctx;
+
+/*
+ * Creates a new parser context. Returns NULL if out of memory.
+ */
+extern parser_ctx* parser_ctx_create(void);
+
+/*
+ * Frees a parser context and its buffers. Command lists parsed with the
+ * context stay valid and must still be freed with parser_free().
+ */
+extern void parser_ctx_free(parser_ctx* ctx);
+
+/*
+ * Same as parser_parse() but uses ctx instead of global state. The status
+ * is available through the functions below instead of parser_status,
+ * parser_message, error_line, and error_column.
+ */
+extern cmds* parser_ctx_parse(parser_ctx* ctx, char* input);
+
+/*
+ * Sets the lookup function for $variable substitutions of ctx (default
+ * getenv(), NULL restores it). It is called on the thread that parses
+ * with ctx, so it only has to be thread safe if it is shared with
+ * contexts parsing on other threads at the same time.
+ */
+extern void parser_ctx_set_lookup(parser_ctx* ctx,
+                                  char* (*lookup)(const char* name));
+
+/*
+ * Incremental parsing of long inputs such as scripts. parser_ctx_begin()
+ * sets the input, and every call of parser_ctx_next() parses only the
+ * next command (up to ';', '&', or the end of line) and returns it as a
+ * list of its own that has to be freed with parser_free(). At the end of
+ * input or on an error NULL is returned; check parser_ctx_status() to
+ * distinguish both cases. Line numbers count from the start of input.
+ * The input must stay unchanged until the last command was freed.
+ */
+extern void parser_ctx_begin(parser_ctx* ctx, char* input);
+extern cmds* parser_ctx_next(parser_ctx* ctx);
+extern enum parser_errors parser_ctx_status(parser_ctx* ctx);
+extern char* parser_ctx_message(parser_ctx* ctx);
+extern int parser_ctx_error_line(parser_ctx* ctx);
+extern int parser_ctx_error_column(parser_ctx* ctx);
+
 /*
  * Visualizes/prints a parsed command list supplied by handle.
  */
 extern void parser_print(cmds* handle);
 
+/**
+ * Parser statistics.
+ */
+
+typedef struct parser_counters /* counted per thread, always enabled      */
+{
+	unsigned long parses;   /* parsed inputs and commands                 */
+	unsigned long allocs;   /* allocations from the arena                 */
+	unsigned long bytes;    /* bytes allocated from the arena             */
+	unsigned long chunks;   /* arena chunks allocated with malloc         */
+	unsigned long reused;   /* arena chunks reused from released lists    */
+	unsigned long grows;    /* reallocations of the token buffers         */
+	unsigned long cache_hits;    /* inputs found in the parse cache       */
+	unsigned long cache_misses;  /* inputs parsed by parser_cache_parse() */
+	unsigned long cache_dropped; /* entries dropped by invalidation       */
+} parser_counters;
+
+/*
+ * Copies the counters of the calling thread to counters and zeroes them
+ * if reset is true.
+ */
+extern void parser_counters_get(parser_counters* counters, int reset);
+
 /*
  * Tests the parser using input and prints the results. Please use the
  * output of this function to file a bug report.
@@ -0,0 +1,218 @@
+/*
+ * ParserBench.c
+ *
+ * Micro-benchmark of the parser: parser_parse/parser_free in a loop over
+ * the test corpus (ParserCorpus.h) and over generated large inputs. Every
+ * workload runs until at least the given time has passed; one line of CSV
+ * per workload is written to stdout, so results of two builds can simply
+ * be compared with diff, join or a spreadsheet.
+ *
+ * Usage: parserbench [seconds per workload] [workload]
+ *
+ * Columns:
+ *   workload        name of the input (see workloads below)
+ *   bytes           length of the input (for the corpus: sum of all inputs)
+ *   commands        parsed commands per iteration (entries of the cmds list)
+ *   iterations      number of parser_parse/parser_free rounds
+ *   seconds         measured time of all rounds
+ *   mb_per_s        input bytes parsed per second (MiB)
+ *   commands_per_s  commands parsed per second
+ *   allocs_per_cmd  arena allocations per parsed command
+ *   chunks_per_iter arena chunks taken from malloc per round
+ *   grows_per_iter  token buffer reallocations per round
+ */
+
+#include <stdbool.h>  /* constants                                       */
+#include <stdio.h>    /* I/O                                             */
+#include <stdlib.h>   /* standard c functions                            */
+#include <string.h>   /* string manipulations                            */
+#include <time.h>     /* clock_gettime                                   */
+
+#include "Parser.h"
+#include "ParserCorpus.h"
+
+#define DEFAULT_SECONDS (0.5)  /* minimum run time of a workload          */
+#define GENERATED_SIZE (1<<20) /* approximate size of generated inputs    */
+
+
+/* generated inputs ---------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* repeats pattern until about GENERATED_SIZE bytes are reached; head and */
+/* tail are written once before and after the repetitions                 */
+static char* repeat(const char* head, const char* pattern, const char* tail)
+{
+	size_t head_len = strlen(head);
+	size_t len = strlen(pattern);
+	size_t tail_len = strlen(tail);
+	size_t n = GENERATED_SIZE/len;
+	char* input = malloc(head_len+n*len+tail_len+1);
+	char* pos = input;
+	size_t i;
+	if (input==NULL) return NULL;
+	memcpy(pos, head, head_len);
+	pos += head_len;
+	for (i=0; i<n; i++)
+	{
+		memcpy(pos, pattern, len);
+		pos += len;
+	}
+	memcpy(pos, tail, tail_len+1);
+	return input;
+}
+
+/* many short commands, each one a line of its own                        */
+static char* gen_commands()
+{
+	return repeat("", "ls -l <in | sort -r >out; cd /tmp\n", "");
+}
+
+/* a single command with a very long argument vector                      */
+static char* gen_argv()
+{
+	return repeat("echo", " arg", "");
+}
+
+/* arguments made of variable substitutions                               */
+static char* gen_variables()
+{
+	return repeat("", "echo $a ${b} pre$c$a ${a}post\n", "");
+}
+
+/* pipes with many stages                                                 */
+static char* gen_pipes()
+{
+	static char line[64*8+2];
+	int i;
+	line[0] = '\0';
+	for (i=0; i<63; i++)
+	{
+		strcat(line, "cat -n |");
+	}
+	strcat(line, " wc -l\n");
+	return repeat("", line, "");
+}
+
+/* quoted and escaped arguments containing special characters             */
+static char* gen_quoting()
+{
+	return repeat("", "echo 'a ; b | c & d' \\; \\| it\\'s 'x'\\$a'y'\n", "");
+}
+
+
+/* measuring ----------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+typedef struct workload
+{
+	const char* name;
+	char* (*generate)();  /* NULL for the corpus                          */
+} workload;
+
+static const workload workloads[] =
+{
+	{ "corpus",    NULL },
+	{ "commands",  gen_commands },
+	{ "argv",      gen_argv },
+	{ "variables", gen_variables },
+	{ "pipes",     gen_pipes },
+	{ "quoting",   gen_quoting }
+};
+
+#define WORKLOADS (sizeof(workloads)/sizeof(workloads[0]))
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/* parses all inputs once and returns the number of parsed commands       */
+static size_t parse_all(char** inputs, size_t n)
+{
+	size_t i, count = 0;
+	cmds* cmd;
+	cmds* elem;
+	for (i=0; i<n; i++)
+	{
+		cmd = parser_parse(inputs[i]);
+		for (elem=cmd; elem!=NULL; elem=elem->next)
+		{
+			count++;
+		}
+		parser_free(cmd);
+	}
+	return count;
+}
+
+/* runs one workload for at least seconds and prints its CSV line         */
+static void run(char** inputs, size_t n, const char* name, double seconds)
+{
+	parser_counters counters;
+	size_t i, bytes = 0, commands;
+	unsigned long iterations = 0;
+	double start, elapsed;
+	for (i=0; i<n; i++)
+	{
+		bytes += strlen(inputs[i]);
+	}
+	/* warm up: fills the arena's spare list and the caches              */
+	commands = parse_all(inputs, n);
+	parser_counters_get(&counters, true);
+	start = now();
+	do
+	{
+		parse_all(inputs, n);
+		iterations++;
+		elapsed = now()-start;
+	}
+	while (elapsed<seconds);
+	parser_counters_get(&counters, true);
+	printf("%s,%zu,%zu,%lu,%.6f,%.2f,%.0f,%.2f,%.3f,%.3f\n",
+	       name, bytes, commands, iterations, elapsed,
+	       bytes*iterations/elapsed/(1024.0*1024.0),
+	       commands*iterations/elapsed,
+	       commands ? (double)counters.allocs/(commands*iterations) : 0.0,
+	       (double)counters.chunks/iterations,
+	       (double)counters.grows/iterations);
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	double seconds = argc>1 ? atof(argv[1]) : DEFAULT_SECONDS;
+	const char* only = argc>2 ? argv[2] : NULL;
+	size_t i;
+	char* input;
+
+	/* variables used by the corpus and the generated inputs             */
+	setenv("a", "var1", true);
+	setenv("b", "var2", true);
+	setenv("c", "var3", true);
+
+	printf("workload,bytes,commands,iterations,seconds,mb_per_s,"
+	       "commands_per_s,allocs_per_cmd,chunks_per_iter,grows_per_iter\n");
+	for (i=0; i<WORKLOADS; i++)
+	{
+		if (only!=NULL && strcmp(only, workloads[i].name))
+		{
+			continue;
+		}
+		if (workloads[i].generate==NULL)
+		{
+			run((char**)parser_corpus, PARSER_CORPUS_LENGTH,
+			    workloads[i].name, seconds);
+			continue;
+		}
+		input = workloads[i].generate();
+		if (input==NULL)
+		{
+			fprintf(stderr, "%s: insufficient memory\n", workloads[i].name);
+			return EXIT_FAILURE;
+		}
+		run(&input, 1, workloads[i].name, seconds);
+		free(input);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/*
+ * ParserCorpus.h
+ *
+ * Inputs shared by the parser tests (Parser.c with PARSER_DEBUG) and the
+ * parser benchmark (ParserBench.c). They cover every builtin, pipes,
+ * redirections, quoting, escaping, variables and all error paths, so new
+ * syntax should be added here to be both tested and measured.
+ * The variables a, b and c are expected to be set.
+ */
+
+static const char* const parser_corpus[] =
+{
+	"",
+	"exit",
+	"cd ..",
+	"cd exit",
+	"cd foo next arguments are ignored",
+	"exit 1",
+	"ls -l",
+	"cat; ls foo",
+	"cat; ; ls foo",
+	"ls -l -a -r   \n   cd \n echo foobar",
+	">file ls",
+	"> out <in cat & echo foo",
+	"missing file >& cd ..",
+	"missing file <; exit",
+	"ls <in -lisa | grep '.pdf' | sort >out",
+	"ls > foo | grep .pdf    | sort",
+	"ls | <foo grep .pdf |   sort",
+	"ls | grep .pdf >bar |   sort",
+	"cd .. | ls",
+	"ls | exit | sort",
+	"ls | sort | cd /bar/foo",
+	"# this is a comment",
+	"> out echo bla # this is a comment echo; $foo; 'open quote \n ls -l",
+	"echo '; >foo <bar exit cd & \n $a | &' & ls -lisa",
+	"echo escaping \\\\ \\a \\< foo \\> bar \\; \\| \\$a \\& hello",
+	"open 'quotation\n is still open",
+	"open escaped char \\",
+	"setenv foo 'bar and barfoo' this is ignored up to here; exit",
+	"setenv foo",
+	"unsetenv foo and this is ignored up to here; exit",
+	"setenv foo 'bar and barfoo'; unsetenv foo; exit",
+	"unsetenv",
+	"set foo $a; export foo; echo $foo",
+	"set foo",
+	"export",
+	"$a> $b& cd ..; exit",
+	"${here <foobar",
+	"echo alloneide'bla'blub\\#\\;$a${b}$c'yeah'",
+	"jobs 13 ignored; bg 1 ignored; fg 3 igno red; bg; fg",
+	"jobs 13; bg 1; fg 3",
+	"jobs foobar",
+	"bg -42",
+	"fg dunno",
+	"hash; hash -r; rehash",
+	"hash foo",
+	"rehash -r",
+	"ls | hash",
+	"source ~/.shellrc; . script arg",
+	"source ~/.shellrc; . script",
+	"source",
+	"ls | source foo",
+	"parallel -j 4 -k gzip -9 {} ::: a b c >log",
+	"parallel echo :::",
+	"parallel -j 0 echo ::: a",
+	"parallel -j -2 echo ::: a",
+	"parallel -x echo ::: a",
+	"parallel ::: a",
+	"parallel echo a",
+	"ls | parallel echo ::: a",
+	"time ls -l | sort -r >out",
+	"time",
+	"ls | time sort",
+	"time cd /tmp",
+	"stats; stats on; stats off; stats reset",
+	"stats foo",
+	"stats on off",
+	"echo a | test -n b | [ 1 ] | printf x | true >out; false",
+	"time time ls; time echo a",
+	"ls | echo | cd",
+	"parallelx; cdx; unsetenvx",
+};
+
+#define PARSER_CORPUS_LENGTH (sizeof(parser_corpus)/sizeof(parser_corpus[0]))
@@ -0,0 +1,111 @@
+/*
+ * Script.c
+ *
+ *  Modul um Skriptdateien ab zu arbeiten
+ *  - shell datei	:	Skript statt interaktiver Eingabe
+ *  - source datei	:	Skript in der laufenden Shell ausfuehren
+ *
+ *  Die Datei wird nicht zeilenweise gelesen, sondern komplett per mmap()
+ *  eingeblendet. Der Parser liest Befehle direkt aus dem Mapping und
+ *  jeder Befehl wird ausgefuehrt bevor der naechste geparst wird
+ *  (cd, setenv usw. wirken also schon auf die folgenden Zeilen).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Parser.h"
+#include "Execute.h"
+#include "Script.h"
+#include "Jobs.h"
+#include "Stats.h"
+#include "Tools.h"
+#include "Vars.h"
+
+/*
+ * Blendet die Datei ein und sorgt fuer ein abschliessendes '\0':
+ * Zuerst wird Platz fuer Datei + eine Seite anonym reserviert (mit Nullen
+ * gefuellt), darueber wird die Datei mit MAP_FIXED gelegt. Der Rest der
+ * letzten Dateiseite und die Extraseite bleiben Null.
+ */
+static char* mapScript(int fd, size_t size, size_t* mapped) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	char* map;
+
+	*mapped = (size / page + 1) * page;
+	map = mmap(NULL, *mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+	if (size > 0
+			&& mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)
+					== MAP_FAILED) {
+		munmap(map, *mapped);
+		return NULL;
+	}
+	madvise(map, size, MADV_SEQUENTIAL);		// wird nur einmal vorwaerts gelesen
+	return map;
+}
+
+int runScript(char* path) {
+	struct stat info;
+	size_t mapped;
+	char* script;
+	int fd, exitShell = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+		fprintf(stderr, "%s: keine lesbare Datei\n", path);
+		close(fd);
+		return -1;
+	}
+	script = mapScript(fd, info.st_size, &mapped);
+	close(fd);							// Mapping bleibt auch ohne fd gueltig
+	if (script == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	/*
+	 * Eigener Parserkontext, damit source auch innerhalb eines Skripts
+	 * (oder mitten in einer Befehlsliste) funktioniert
+	 */
+	parser_ctx* ctx = parser_ctx_create();
+	if (ctx == NULL) {
+		munmap(script, mapped);
+		return -1;
+	}
+	parser_ctx_set_lookup(ctx, getVar);	// $name aus der Variablentabelle
+	parser_ctx_begin(ctx, script);
+
+	cmds* befehl;
+	struct timespec ts;
+	while (!exitShell) {
+		STAT_START(ts);
+		if ((befehl = parser_ctx_next(ctx)) == NULL)
+			break;
+		STAT_STOP(STAT_PARSE, ts);
+		checkPath();					// neue Programme in $PATH?
+		exitShell = doThis(befehl);		// Befehl sofort ausfuehren
+		parser_free(befehl);
+		reportJobs(0);					// fertige Hintergrundjobs vergessen
+	}
+
+	if (parser_ctx_status(ctx) != PARSER_OK) {
+		fprintf(stderr, "%s:%i:%i: %s\n", path, parser_ctx_error_line(ctx) + 1,
+				parser_ctx_error_column(ctx), parser_ctx_message(ctx));
+		exitShell = -1;
+	}
+
+	parser_ctx_free(ctx);
+	munmap(script, mapped);
+	return exitShell;
+}
@@ -0,0 +1,10 @@
+/*
+ * Script.h
+ */
+
+/*
+ * Fuehrt die Befehle einer Skriptdatei nacheinander aus (ohne readline).
+ * Rueckgabe: 1 wenn das Skript exit ausgefuehrt hat, 0 wenn es bis zum
+ * Ende gelaufen ist, -1 bei Fehlern (Datei nicht lesbar, Syntaxfehler)
+ */
+int runScript(char* path);
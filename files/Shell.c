@@ -26,9 +26,25 @@
 #include "Parser.h"
 #include "Execute.h"
 #include "Tools.h"
+#include "Script.h"
+#include "Jobs.h"
+#include "Stats.h"
+#include "Vars.h"
 
 int exitShell, signals;
 
+/*
+ * Prompt-Cache: das Prompt wird nur neu gebaut, wenn sich eine Eingabe
+ * aendert (cwd nach cd, Fensterbreite nach SIGWINCH). User und PID
+ * aendern sich nie und werden einmal beim Start geholt.
+ */
+static char shell_prompt[1024];
+static char* cwd;						// aktuelles Verzeichnis (malloc)
+static char* user;
+static pid_t shellPid;
+static unsigned short columns;			// Breite des Terminals
+static volatile sig_atomic_t winchFlag = 1;	// Fenstergroesse neu holen
+
 
 
 /*
@@ -36,6 +52,9 @@ int exitShell, signals;
  * Implementiert den Code der bei ensprechdem Signal ausgef�hrt wird
  */
 void sig_handler(int signo) {
+	if (signo == SIGWINCH)
+		winchFlag = 1;
+
 	if ((signo > 0) && (signals)) {
 		char* signalbeschreibung;
 		signalbeschreibung = getSignalText(signo);
@@ -49,28 +68,102 @@ void sig_handler(int signo) {
 
 }
 
+/*
+ * Liefert das Prompt, gebaut wird es nur nach cd oder SIGWINCH neu.
+ * Anhand der Fenstergroesse wird entschieden
+ * ob ein kurzes oder langes Prompt genutzt wird
+ */
+static char* getPrompt() {
+	int changed = 0;
+
+	if (cwdChanged) {
+		cwdChanged = 0;
+		free(cwd);
+		cwd = getcwd(NULL, 0);
+		changed = 1;
+	}
+	if (winchFlag) {
+		struct winsize w;
+		winchFlag = 0;
+		columns = ioctl(STDIN_FILENO, TIOCGWINSZ, &w) == 0 ? w.ws_col : 0;
+		changed = 1;
+	}
+	if (!changed)
+		return shell_prompt;
+
+	if (cwd != NULL && columns > strlen(cwd) * 3) {			// Grosses Prompt
+		snprintf(shell_prompt, sizeof(shell_prompt),
+				"\033[0;33mPID(%i):\033[0;32m%s\033[0;0m@\033[0;36m%s \033[0;31m>>\033[0;0m  ",
+				shellPid, user, cwd);
+
+	} else
+		snprintf(shell_prompt, sizeof(shell_prompt),
+				" \033[0;31m>>\033[0;0m ");				// Kleines Prompt
+
+	return shell_prompt;
+}
+
 int main(int argc, char *argv[]) {
 	/*
 	 * Ueberpruefen ob shell argumente hat
 	 * -s : Signalausgabe
 	 * -d : Debugmodus + Signalausgabe
+	 * -f : Programme mit fork() + exec() starten
+	 * -p : Programme mit posix_spawn() starten
+	 * -c befehle : nur die Befehle ausfuehren und beenden
+	 * datei : Befehle aus der Skriptdatei statt von der Tastatur lesen
 	 */
-
-
-	argc--;
-	if (!strcmp(argv[argc], "-s")) {
-		signals++;
-		printf("Ausgabe von Signalen aktiviert.\n");
-	}
-	if (!strcmp(argv[argc], "-d")) {
-		signals++;
-		debug++;
-		printf("Debugmodus und Signalausgabe aktiviert\n");
+	char* script = NULL;
+	char* command = NULL;
+	int arg;
+	for (arg = 1; arg < argc; arg++) {
+		if (!strcmp(argv[arg], "-c") && arg + 1 < argc) {
+			command = argv[++arg];
+			continue;
+		}
+		if (argv[arg][0] != '-' && script == NULL)
+			script = argv[arg];
+		if (!strcmp(argv[arg], "-s")) {
+			signals++;
+			printf("Ausgabe von Signalen aktiviert.\n");
+		}
+		if (!strcmp(argv[arg], "-d")) {
+			signals++;
+			debug++;
+			printf("Debugmodus und Signalausgabe aktiviert\n");
+		}
+		if (!strcmp(argv[arg], "-f"))
+			spawnMode = SPAWN_FORK;
+		if (!strcmp(argv[arg], "-p"))
+			spawnMode = SPAWN_POSIX;
 	}
 
-	createCacheFiles();
+	initVars();							// environ in die Variablentabelle
+	// Kinder per SIGCHLD einsammeln, interaktiv mit Jobkontrolle
+	initJobs(script == NULL && command == NULL);
 
-	shell_pgid = getpid();			// ProzessID der Shell
+	/*
+	 * Skriptmodus: kein readline, kein Prompt, keine History und keine
+	 * eigenen Signalhandler (Strg+C beendet das Skript wie gewohnt)
+	 */
+	if (script != NULL && command == NULL)
+		return runScript(script) < 0 ? EXIT_FAILURE : lastStatus;
+
+	/*
+	 * -c Modus: wie Skriptmodus ohne jede interaktive Vorbereitung,
+	 * ein einfaches Programm am Ende ersetzt die Shell per exec()
+	 */
+	if (command != NULL) {
+		cmds* liste = parser_parse(command);
+		if (parser_status != PARSER_OK) {
+			fprintf(stderr, "-c: %s\n", parser_message);
+			return 2;
+		}
+		execLast = 1;
+		doThis(liste);
+		parser_free(liste);
+		return lastStatus;				// Status des letzten Befehls
+	}
 
 	/*
 	 * Signale registrieren
@@ -79,14 +172,19 @@ int main(int argc, char *argv[]) {
 	 *
 	 * Bem: Einige Signale werden unterdrueckt, da diese stoerende Nachrichten erzeugen,
 	 * weils sie nicht aktiviert werden k�nnen!
-	 * 		--> SIGUSR2 (17), SIGKILL, Alle Signale > 30,
+	 * 		--> SIGKILL, Alle Signale > 30,
+	 * SIGCHLD gehoert dem Handler aus Jobs.c (sammelt die Kinder ein) und
+	 * darf hier nicht ueberschrieben werden.
 	 */
 	int signalNumber;
 	for (signalNumber = 1; signalNumber < 30; ++signalNumber) {
 		if (signalNumber == (SIGKILL))
 			continue;
-		if (signalNumber == (17))
-			continue;
+		if (signalNumber == SIGCHLD)
+			continue;					// Handler aus initJobs()
+		if (jobControlOn && (signalNumber == SIGTSTP || signalNumber == SIGTTIN
+				|| signalNumber == SIGTTOU))
+			continue;					// bleiben ignoriert (Jobs.c)
 
 		if (signal(signalNumber, sig_handler) == SIG_ERR)
 			printf("\ncan't catch %s\n", getSignalText(signalNumber));
@@ -96,29 +194,19 @@ int main(int argc, char *argv[]) {
 	 * Hier beginnt die eigentliche Shell
 	 * Create Prompt, read line & execute
 	 */
-	char* input, shell_prompt[1024];
+	char* input;
 
 	rl_bind_key('\t', rl_complete); 	// Autocomplete mit TAB
 
-	while (!exitShell) {
-		/*
-		 * Anhand der Fenstergroesse wird entschieden
-		 * ob ein kurzes oder langes Prompt genutzt wird
-		 */
-		struct winsize w;
-		ioctl(0, TIOCGWINSZ, &w);
-		int size = strlen(getcwd(NULL, 512)) * 3;
+	shellPid = getpid();
+	user = getenv("USER");
+	if (user == NULL)
+		user = "";
 
-		if (w.ws_col > size) {								// Grosses Prompt
-			snprintf(shell_prompt, sizeof(shell_prompt),
-					"\033[0;33mPID(%i):\033[0;32m%s\033[0;0m@\033[0;36m%s \033[0;31m>>\033[0;0m  ",
-					getpid(), getenv("USER"), getcwd(NULL, 512));
-
-		} else
-			snprintf(shell_prompt, sizeof(shell_prompt),
-					" \033[0;31m>>\033[0;0m ");				// Kleines Prompt
+	while (!exitShell) {
+		reportJobs(1);							// fertige Hintergrundjobs melden
 
-		input = readline(shell_prompt);
+		input = readline(getPrompt());
 
 		if (!input)
 			break;
@@ -127,15 +215,20 @@ int main(int argc, char *argv[]) {
 
 		if (debug)
 			parser_test(input);
-		cmds* liste = parser_parse(input); 		// Input parsen
+		checkPath();							// neue Programme in $PATH?
+		struct timespec ts;
+		STAT_START(ts);
+		cmds* liste = parser_cache_parse(input);	// Input parsen (oder aus dem Cache)
+		STAT_STOP(STAT_PARSE, ts);
 
 		exitShell = doThis(liste);				// Befehlsliste abarbeiten
 
+		parser_cache_release(liste);			// bleibt fuer Wiederholungen im Cache
+
+		free(input);							// fertige Eingabe loeschen
 	}
 
-	free(input);		// fertige Eingabe loeschen
-	remove(PIPE1);	// PipeDumps entfernen
-	remove(PIPE2);
+	free(cwd);
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,133 @@
+/*
+ * Stats.c
+ *
+ *  Builtin stats [on|off|reset]
+ *  - Latenzen von parse, lookup, spawn und wait als Histogramme
+ *  - stats zeigt Anzahl, p50, p99, max und Mittelwert je Phase sowie die
+ *    Zaehler des Parsers (Allokationen aus der Arena, Parse-Cache usw.)
+ *  - ausgeschaltet kostet jede Messstelle nur den Test von statsOn
+ *
+ *  Die Histogramme sind log-linear: je Zweierpotenz von Nanosekunden vier
+ *  Eimer, d.h. jeder Wert ist auf etwa 25% genau. Ein Eintrag ist nur ein
+ *  Index und ein Inkrement, es wird nichts sortiert oder allokiert.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Parser.h"
+#include "Stats.h"
+
+#define SUB_BITS 2						// 4 Eimer je Zweierpotenz
+#define SUB (1 << SUB_BITS)
+#define BUCKETS (64 * SUB)
+
+typedef struct histogram {
+	uint64_t bucket[BUCKETS];
+	uint64_t count;
+	uint64_t sum;						// fuer den Mittelwert
+	uint64_t max;
+} histogram;
+
+int statsOn = 0;
+
+static histogram hist[STAT_PHASES];
+
+static const char* phaseName[STAT_PHASES] = { "parse", "lookup", "spawn",
+		"wait" };
+
+/*
+ * Eimer fuer ns: kleine Werte direkt, sonst die Stelle des hoechsten
+ * Bits und die SUB_BITS Bits darunter
+ */
+static int bucketOf(uint64_t ns) {
+	if (ns < SUB)
+		return ns;
+	int e = 63 - __builtin_clzll(ns);
+	return (e - SUB_BITS + 1) * SUB + ((ns >> (e - SUB_BITS)) & (SUB - 1));
+}
+
+/*
+ * Kleinster Wert, der in den Eimer faellt
+ */
+static uint64_t bucketLow(int b) {
+	if (b < SUB)
+		return b;
+	int e = b / SUB + SUB_BITS - 1;
+	return (uint64_t) (SUB + b % SUB) << (e - SUB_BITS);
+}
+
+void recordStat(enum stat_phase phase, struct timespec* start) {
+	struct timespec end;
+	histogram* h = &hist[phase];
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	int64_t ns = (int64_t) (end.tv_sec - start->tv_sec) * 1000000000
+			+ (end.tv_nsec - start->tv_nsec);
+	if (ns < 0)
+		ns = 0;
+	h->bucket[bucketOf(ns)]++;
+	h->count++;
+	h->sum += ns;
+	if ((uint64_t) ns > h->max)
+		h->max = ns;
+}
+
+void resetStats() {
+	parser_counters ignored;
+
+	memset(hist, 0, sizeof(hist));
+	parser_counters_get(&ignored, 1);
+}
+
+/*
+ * Wert, unter dem p Promille der Messungen liegen (Obergrenze des Eimers,
+ * hoechstens max)
+ */
+static uint64_t percentile(histogram* h, int p) {
+	uint64_t want = (h->count * p + 999) / 1000, seen = 0;
+	int b;
+
+	for (b = 0; b < BUCKETS - 1; b++) {
+		seen += h->bucket[b];
+		if (seen >= want)
+			break;
+	}
+	uint64_t high = bucketLow(b + 1) - 1;
+	return high < h->max ? high : h->max;
+}
+
+/*
+ * Gibt ns als us mit einer Nachkommastelle aus
+ */
+static void printTime(uint64_t ns) {
+	printf(" %11.1f", ns / 1000.0);
+}
+
+void printStats() {
+	parser_counters c;
+	int i;
+
+	printf("Messung %s\n", statsOn ? "an" : "aus");
+	printf("%-8s %10s %11s %11s %11s %11s\n", "Phase", "Anzahl", "p50 us",
+			"p99 us", "max us", "Mittel us");
+	for (i = 0; i < STAT_PHASES; i++) {
+		histogram* h = &hist[i];
+		printf("%-8s %10llu", phaseName[i], (unsigned long long) h->count);
+		if (h->count > 0) {
+			printTime(percentile(h, 500));
+			printTime(percentile(h, 990));
+			printTime(h->max);
+			printTime(h->sum / h->count);
+		}
+		printf("\n");
+	}
+
+	parser_counters_get(&c, 0);
+	printf("Parser: %lu Eingaben, %lu Allokationen (%lu Bytes), "
+			"%lu neue / %lu wiederverwendete Bloecke, %lu Puffervergroesserungen\n",
+			c.parses, c.allocs, c.bytes, c.chunks, c.reused, c.grows);
+	printf("Cache: %lu Treffer, %lu Fehlschlaege, %lu invalidiert\n",
+			c.cache_hits, c.cache_misses, c.cache_dropped);
+}
@@ -0,0 +1,31 @@
+/*
+ * Stats.h
+ */
+
+#include <time.h>
+
+enum stat_phase {
+	STAT_PARSE,			// Eingabe parsen
+	STAT_LOOKUP,		// Programm im PATH suchen
+	STAT_SPAWN,			// fork()/posix_spawn() in der Shell
+	STAT_WAIT,			// auf einen Vordergrundjob warten
+	STAT_PHASES
+};
+
+extern int statsOn;		// Messung eingeschaltet (builtin stats on/off)
+
+/*
+ * Merkt sich den Startzeitpunkt, nur wenn gemessen wird
+ */
+#define STAT_START(ts) \
+	do { if (statsOn) clock_gettime(CLOCK_MONOTONIC, &(ts)); } while (0)
+
+/*
+ * Traegt die Zeit seit STAT_START in das Histogramm der Phase ein
+ */
+#define STAT_STOP(phase, ts) \
+	do { if (statsOn) recordStat(phase, &(ts)); } while (0)
+
+void recordStat(enum stat_phase phase, struct timespec* start);
+void resetStats();
+void printStats();
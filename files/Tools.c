@@ -7,14 +7,21 @@
  *	nuetzliche Funktionen
  */
 
+#define _GNU_SOURCE		// O_PATH, AT_EMPTY_PATH, environ
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include "Tools.h"
+#include "Vars.h"
 #include <errno.h>
 
+int debug;
+
 #define SIGNAL_PATH "signals"
 
 /*
@@ -44,90 +51,259 @@
  */
 
 /*
- * Erstelle PipeDump-Pfade
- * Zwischenspeicher fuer die einzelnen Pipeprogramme
+ * Gibt des Pfad zur gesuchten Datei zur�ck
+ * Dabei wird in den Ordnern aus $PATH gesucht (in dieser Reihenfolge).
+ * Fuer jeden Ordner wird ein fd (O_PATH) offen gehalten, pro Ordner
+ * kostet eine Suche dann nur ein faccessat() statt eines readdir().
+ */
+#define DEFAULT_PATH "/bin:/usr/bin:/sbin"
+
+static char** pathDirs;			// Ordner aus $PATH
+static int* pathFds;			// fd je Ordner (-1 falls nicht vorhanden)
+static struct timespec* pathTimes;	// mtime je Ordner
+static int pathCount;
+static char* pathCopy;			// Kopie von $PATH, in pathDirs zerlegt
+
+/*
+ * Hashtabelle: Programmname -> Pfad
+ * Auch erfolglose Suchen werden gemerkt (path == NULL), damit ein
+ * fehlendes Programm nicht jedes Mal alle Ordner durchsuchen laesst.
+ * Die Tabelle wird geleert, sobald sich einer der Ordner aus $PATH
+ * aendert (mtime), $PATH neu gesetzt oder rehash aufgerufen wird.
  */
-void createCacheFiles() {
-	FILE* createFile;
+#define HASH_SIZE 256
 
-	char* home = getenv("HOME");
-	strcpy(PIPE1, strcat(home, "/.PipeDump1"));
+typedef struct command {
+	char* name;
+	char* path;					// NULL: nicht gefunden
+	int dir;					// Index in pathDirs
+	unsigned hits;				// Anzahl Aufrufe seit dem Eintragen
+	struct command* next;
+} command;
 
-	createFile = fopen(PIPE1, "w");
-	if(createFile == NULL){
-		perror("1 Fehlende Schreibrechte fr Cachefiles.");
+static command* commands[HASH_SIZE];
+
+static unsigned hashName(char* name) {
+	unsigned h = 5381;
+	while (*name)
+		h = h * 33 + (unsigned char) *name++;
+	return h % HASH_SIZE;
+}
+
+/*
+ * Loescht alle gemerkten Pfade (rehash, hash -r)
+ */
+void clearHash() {
+	int i;
+	for (i = 0; i < HASH_SIZE; i++) {
+		while (commands[i] != NULL) {
+			command* old = commands[i];
+			commands[i] = old->next;
+			free(old->name);
+			free(old->path);
+			free(old);
+		}
 	}
-	fclose(createFile);
+}
 
-	if (debug) {
-		printf("cachfile @%s\n", PIPE1);
+/*
+ * Gibt die gemerkten Pfade aus (hash)
+ */
+void printHash() {
+	int i;
+	command* c;
+	printf("hits\tcommand\n");
+	for (i = 0; i < HASH_SIZE; i++) {
+		for (c = commands[i]; c != NULL; c = c->next) {
+			if (c->path)
+				printf("%4u\t%s\n", c->hits, c->path);
+			else
+				printf("%4u\t%s (nicht gefunden)\n", c->hits, c->name);
+		}
 	}
+}
 
-	home[strlen(home) - 11] = '\0';
-	strcpy(PIPE2, strcat(home, "/.PipeDump2"));
+/*
+ * Liest $PATH neu ein und oeffnet die Ordner (nach setenv/set/unsetenv PATH).
+ * Leere Eintraege stehen wie ueblich fuer das aktuelle Verzeichnis.
+ */
+void updatePath() {
+	int i;
+	char* env = getVar("PATH");
+	char* dir;
 
-	createFile = fopen(PIPE2, "w");
-	if(createFile == NULL){
-		perror("Fehlende Schreibrechte fr Cachefiles.");
+	for (i = 0; i < pathCount; i++) {
+		if (pathFds[i] >= 0 && pathFds[i] != AT_FDCWD)
+			close(pathFds[i]);
 	}
-	fclose(createFile);
+	free(pathDirs);
+	free(pathFds);
+	free(pathTimes);
+	free(pathCopy);
+	clearHash();
 
-	if (debug) {
-		printf("cachfile @%s\n", PIPE2);
+	pathCopy = strdup(env ? env : DEFAULT_PATH);
+	pathCount = 1;
+	for (dir = pathCopy; *dir; dir++) {
+		if (*dir == ':')
+			pathCount++;
+	}
+	pathDirs = (char**) malloc(pathCount * sizeof(char*));
+	pathFds = (int*) malloc(pathCount * sizeof(int));
+	pathTimes = (struct timespec*) calloc(pathCount, sizeof(struct timespec));
+
+	for (i = 0, dir = pathCopy; i < pathCount; i++) {
+		char* end = strchr(dir, ':');
+		if (end)
+			*end = '\0';
+		pathDirs[i] = *dir ? dir : ".";
+		pathFds[i] = *dir ? open(dir, O_PATH | O_DIRECTORY | O_CLOEXEC) : AT_FDCWD;
+		if (debug)
+			printf("PATH[%d] : %s (fd %d)\n", i, pathDirs[i], pathFds[i]);
+		if (end)
+			dir = end + 1;
 	}
 }
 
 /*
- * Gibt des Pfad zur gesuchten Datei zur�ck
- * Dabei wird nur in den Ordnern gesucht, die unter lookup abgelegt sind.
- * (Idee: Umgebungsvariablen in Datei ablegen)
+ * Prueft, ob sich einer der Ordner aus $PATH seit dem letzten Aufruf
+ * geaendert hat oder ein fehlender Ordner angelegt wurde, und leert dann
+ * die Tabelle. Kostet ein fstatat() je
+ * Ordner und wird deshalb nur einmal pro Eingabe bzw. Skriptbefehl
+ * aufgerufen, nicht bei jeder Suche.
  */
-char result[256];
-DIR *dirHandle;
-struct dirent * dirEntry;
+void checkPath() {
+	int changed = 0;
+	int i;
+	struct stat st;
+
+	if (pathFds == NULL)
+		updatePath();
+
+	for (i = 0; i < pathCount; i++) {
+		if (pathFds[i] < 0 && pathFds[i] != AT_FDCWD) {
+			// fehlte bisher: inzwischen angelegt? (auch negative Eintraege
+			// der Tabelle sind dann falsch)
+			pathFds[i] = open(pathDirs[i], O_PATH | O_DIRECTORY | O_CLOEXEC);
+			if (pathFds[i] < 0)
+				continue;
+			if (debug)
+				printf("PATH[%d] : %s (fd %d)\n", i, pathDirs[i], pathFds[i]);
+		}
+		if (fstatat(pathFds[i], "", &st, AT_EMPTY_PATH) < 0)
+			continue;
+		if (st.st_mtim.tv_sec != pathTimes[i].tv_sec
+				|| st.st_mtim.tv_nsec != pathTimes[i].tv_nsec) {
+			pathTimes[i] = st.st_mtim;
+			changed = 1;
+		}
+	}
+	if (changed) {
+		if (debug)
+			printf("Suchpfade geaendert, leere Hashtabelle\n");
+		clearHash();
+	}
+}
 
 /*
- * Durchsucht alle Ordner aus lookup nach file mit $filename
- * Gibt Pfad dahin zurck.
+ * Nach cd: relative Eintraege in $PATH (leer, ".", "bin") zeigen jetzt
+ * auf andere Ordner, also neu oeffnen und die Tabelle leeren
  */
-char * whereIs(char* filename) {
-	result[0] = '\0';
-	char * cwd_tmp = getcwd(NULL, 1024);
-	strcat(cwd_tmp, "/");
-	char * lookup[] = { "/bin/", "/usr/bin/", "/sbin/", cwd_tmp };
-
-	int iterateLookup = 0;
-	while (iterateLookup < sizeof(lookup) / sizeof(char*)) {		// iteriert Ordner
-		int iterateDir = 1;
-		char* currentPath = lookup[iterateLookup];
+void forgetCwdHash() {
+	int i;
+	for (i = 0; i < pathCount; i++) {
+		if (pathDirs[i][0] != '/') {
+			updatePath();
+			return;
+		}
+	}
+}
 
-		dirHandle = opendir(currentPath);
+/*
+ * Sucht filename in den Ordnern aus $PATH, pro Ordner ein fstatat():
+ * regulaere Datei mit mindestens einem x-Bit. Ob genau dieser Benutzer
+ * sie ausfuehren darf, meldet erst exec() (wie bei anderen Shells).
+ * Gibt den Index des Ordners zurueck, -1 falls nicht gefunden.
+ */
+static int searchPath(char* filename) {
+	int i;
+	struct stat st;
 
+	for (i = 0; i < pathCount; i++) {
+		if (pathFds[i] < 0 && pathFds[i] != AT_FDCWD)
+			continue;
 		if (debug) {
-			printf("Durchsuche : %s\n", currentPath);
+			printf("Durchsuche : %s\n", pathDirs[i]);
 		}
+		if (fstatat(pathFds[i], filename, &st, 0) == 0 && S_ISREG(st.st_mode)
+				&& (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)))
+			return i;
+	}
+	return -1;
+}
 
-		if (dirHandle == NULL) {
-			perror("opendir() error");
-		}
+/*
+ * Sucht filename zuerst in der Hashtabelle, sonst in den Ordnern
+ * aus $PATH, und merkt sich das Ergebnis.
+ * Enthaelt filename einen '/', wird nicht gesucht.
+ * In dirfd (falls != NULL) steht danach der fd des Ordners fuer execAt().
+ * Der Pfad gehoert der Hashtabelle und darf nicht freigegeben werden.
+ */
+char * whereIs(char* filename, int* dirfd) {
+	if (strchr(filename, '/') != NULL) {
+		if (dirfd)
+			*dirfd = AT_FDCWD;
+		return access(filename, X_OK) == 0 ? filename : NULL;
+	}
+
+	if (pathFds == NULL)
+		updatePath();
+
+	unsigned h = hashName(filename);
+	command* c;
+	for (c = commands[h]; c != NULL; c = c->next) {
+		if (!strcmp(c->name, filename))
+			break;
+	}
 
-		if (dirHandle) {
-			while (0 != (dirEntry = readdir(dirHandle))) {		// iteriert Files
-				if (dirEntry == NULL) {
-					perror("readdir() error");
-				}
-				if (!strcmp(dirEntry->d_name, filename)) {
-					strcat(result, currentPath);
-					strcat(result, filename);
-					return result;
-				}
-				iterateDir++;
-			}
+	if (c == NULL) {
+		int dir = searchPath(filename);
+
+		c = (command*) malloc(sizeof(command));
+		if (c == NULL)
+			return NULL;
+		c->name = strdup(filename);
+		c->path = NULL;
+		c->dir = dir;
+		c->hits = 0;
+		if (dir >= 0) {
+			c->path = (char*) malloc(strlen(pathDirs[dir]) + strlen(filename) + 2);
+			sprintf(c->path, "%s/%s", pathDirs[dir], filename);
 		}
-		closedir(dirHandle);
-		iterateLookup++;
+		c->next = commands[h];
+		commands[h] = c;
 	}
-	return NULL;
+
+	c->hits++;
+	if (dirfd && c->path)
+		*dirfd = pathFds[c->dir];
+	return c->path;
+}
+
+/*
+ * Fuehrt das von whereIs() gefundene Programm aus.
+ * Mit execveat() relativ zum Ordner-fd, damit der Pfad nicht noch einmal
+ * aufgeloest werden muss. execv() ist der Rueckfall fuer alte Kernel und
+ * fuer Skripte (#!), die execveat() mit O_CLOEXEC-fd nicht starten kann.
+ * Kehrt nur im Fehlerfall zurueck.
+ */
+int execAt(int dirfd, char* path, char** argv) {
+#ifdef SYS_execveat
+	char* name = strrchr(path, '/');
+	if (dirfd != AT_FDCWD && name != NULL)
+		syscall(SYS_execveat, dirfd, name + 1, argv, environ, 0);
+#endif
+	return execv(path, argv);
 }
 
 /*
@@ -10,12 +10,13 @@
  * sonst NULL
  */
 
-int debug;
+extern int debug;
 
-char PIPE1[265];
-char PIPE2[265];
-
-char * whereIs(char* filename);
+char * whereIs(char* filename, int* dirfd);
+int execAt(int dirfd, char* path, char** argv);
+void updatePath();
+void checkPath();
+void forgetCwdHash();
+void clearHash();
+void printHash();
 char * getSignalText(int signo);
-char * getPathToCacheFile();
-void createCacheFiles();
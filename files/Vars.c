@@ -0,0 +1,216 @@
+/*
+ * Vars.c
+ *
+ *  Variablen der Shell in einer Hashtabelle
+ *  - setenv name value : exportiert (auch in environ fuer die Kinder)
+ *  - set name value    : nur in der Shell sichtbar
+ *  - export name       : macht eine Variable der Shell zur exportierten
+ *  - unsetenv name     : loescht beide Arten
+ *
+ *  $name liest der Parser ueber getVar() in O(1), statt bei jeder
+ *  Ersetzung environ mit getenv() linear zu durchsuchen. environ wird
+ *  nur bei Aenderungen exportierter Variablen angepasst, Kinder erben
+ *  also weiterhin genau die exportierten Variablen.
+ */
+
+#define _GNU_SOURCE		// environ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "Parser.h"
+#include "Vars.h"
+
+#define VARS_MIN 512			// Anfangsgroesse, Umgebungen haben oft 300+
+
+typedef struct var {
+	struct var* next;			// naechste Variable im selben Eimer
+	unsigned long hash;
+	int exported;				// auch in environ?
+	char* value;
+	char name[];
+} var;
+
+static var** table;
+static size_t size;				// Anzahl Eimer (Zweierpotenz)
+static size_t count;			// Anzahl Variablen
+
+/*
+ * FNV-1a ueber den Namen, len bekommt die Laenge
+ */
+static unsigned long hashName(const char* name, size_t* len) {
+	unsigned long hash = 2166136261UL;
+	size_t i;
+	for (i = 0; name[i] != '\0'; i++)
+		hash = (hash ^ (unsigned char) name[i]) * 16777619UL;
+	*len = i;
+	return hash;
+}
+
+/*
+ * Sucht die Variable, prev zeigt danach auf den Zeiger auf sie
+ * (bzw. auf das Ende der Kette)
+ */
+static var* findVar(const char* name, unsigned long hash, var*** prev) {
+	var** p;
+	for (p = &table[hash & (size - 1)]; *p != NULL; p = &(*p)->next) {
+		if ((*p)->hash == hash && !strcmp((*p)->name, name))
+			break;
+	}
+	if (prev != NULL)
+		*prev = p;
+	return *p;
+}
+
+/*
+ * Verdoppelt die Tabelle, wenn sie voll ist (Ketten bleiben kurz)
+ */
+static void growTable() {
+	size_t newSize = size * 2;
+	var** newTable = calloc(newSize, sizeof(var*));
+	var* v;
+	var* next;
+	size_t i;
+	if (newTable == NULL)
+		return;					// laeuft mit laengeren Ketten weiter
+	for (i = 0; i < size; i++) {
+		for (v = table[i]; v != NULL; v = next) {
+			next = v->next;
+			v->next = newTable[v->hash & (newSize - 1)];
+			newTable[v->hash & (newSize - 1)] = v;
+		}
+	}
+	free(table);
+	table = newTable;
+	size = newSize;
+}
+
+/*
+ * Legt die Variable an oder aendert ihren Wert (ohne environ)
+ */
+static var* storeVar(const char* name, size_t len, const char* value) {
+	unsigned long hash;
+	size_t nameLen;
+	var** prev;
+	var* v;
+	char* copy = strdup(value);
+	char* key;
+	if (copy == NULL)
+		return NULL;
+
+	key = strndup(name, len);	// name kann aus environ ("name=wert") sein
+	if (key == NULL) {
+		free(copy);
+		return NULL;
+	}
+	hash = hashName(key, &nameLen);
+	v = findVar(key, hash, &prev);
+	if (v == NULL) {
+		v = malloc(sizeof(var) + nameLen + 1);
+		if (v == NULL) {
+			free(key);
+			free(copy);
+			return NULL;
+		}
+		memcpy(v->name, key, nameLen + 1);
+		v->hash = hash;
+		v->exported = 0;
+		v->value = NULL;
+		v->next = NULL;
+		*prev = v;
+		if (++count > size)
+			growTable();
+	}
+	free(key);
+	free(v->value);
+	v->value = copy;
+	return v;
+}
+
+void initVars() {
+	char** env;
+	char* eq;
+	var* v;
+	size_t n = 0;
+
+	for (env = environ; *env != NULL; env++)
+		n++;
+	for (size = VARS_MIN; size < n; size *= 2)
+		;
+	table = calloc(size, sizeof(var*));
+	if (table == NULL) {
+		perror("initVars");
+		exit(EXIT_FAILURE);
+	}
+	for (env = environ; *env != NULL; env++) {
+		eq = strchr(*env, '=');
+		if (eq == NULL)
+			continue;
+		v = storeVar(*env, eq - *env, eq + 1);
+		if (v != NULL)
+			v->exported = 1;
+	}
+	parser_set_lookup(getVar);
+}
+
+char* getVar(const char* name) {
+	size_t len;
+	var* v = findVar(name, hashName(name, &len), NULL);
+	return v != NULL ? v->value : NULL;
+}
+
+int setVar(const char* name, const char* value, int export) {
+	size_t len;
+	var* old;
+	var* v;
+
+	// erst pruefen und environ setzen, die Tabelle aendert sich nur,
+	// wenn alles geklappt hat
+	if (*name == '\0' || strchr(name, '=') != NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	old = findVar(name, hashName(name, &len), NULL);
+	export = export || (old != NULL && old->exported);
+	if (export && setenv(name, value, 1) < 0)
+		return -1;
+	v = storeVar(name, len, value);
+	if (v == NULL) {
+		if (old != NULL && old->exported)	// environ wieder wie die Tabelle
+			setenv(name, old->value, 1);
+		else if (export)
+			unsetenv(name);
+		return -1;
+	}
+	v->exported = export;
+	parser_cache_invalidate(name);	// Zeilen mit $name neu parsen
+	return 0;
+}
+
+int exportVar(const char* name) {
+	size_t len;
+	var* v = findVar(name, hashName(name, &len), NULL);
+	if (v == NULL)
+		return -1;
+	if (!v->exported && setenv(name, v->value, 1) < 0)
+		return -1;
+	v->exported = 1;
+	return 0;
+}
+
+void unsetVar(const char* name) {
+	size_t len;
+	var** prev;
+	var* v = findVar(name, hashName(name, &len), &prev);
+	unsetenv(name);
+	if (v == NULL)
+		return;
+	*prev = v->next;
+	count--;
+	free(v->value);
+	free(v);
+	parser_cache_invalidate(name);
+}
@@ -0,0 +1,33 @@
+/*
+ * Vars.h
+ */
+
+/*
+ * Uebernimmt environ als exportierte Variablen und meldet getVar()
+ * fuer $name in parser_parse() an (Skripte: eigener Kontext in Script.c).
+ * Die Tabelle ist nicht threadsicher, nur der Hauptthread benutzt sie.
+ */
+void initVars();
+
+/*
+ * Wert der Variablen oder NULL, gueltig bis zur naechsten Aenderung
+ */
+char* getVar(const char* name);
+
+/*
+ * Setzt die Variable. export != 0 exportiert sie, sonst bleibt eine
+ * exportierte Variable exportiert und eine neue ist nur in der Shell
+ * sichtbar. Rueckgabe: 0 oder -1 (ungueltiger Name, kein Speicher),
+ * bei Fehlern bleiben Tabelle und environ unveraendert
+ */
+int setVar(const char* name, const char* value, int export);
+
+/*
+ * Exportiert eine gesetzte Variable. Rueckgabe: 0 oder -1 (nicht gesetzt)
+ */
+int exportVar(const char* name);
+
+/*
+ * Loescht die Variable aus der Shell und aus environ
+ */
+void unsetVar(const char* name);
@@ -0,0 +1,93 @@
+#!/bin/bash
+#
+# test.sh
+#
+# Regressionstests der Shell von aussen (Aufruf: ./test.sh).
+# Die Shell muss vorher mit compile.sh gebaut sein (oder SHELL_BIN setzen).
+# Jeder Fall vergleicht Ausgabe und Exitstatus, am Ende steht die Anzahl
+# der Fehler; der Exitstatus ist 0, wenn alle Faelle stimmen.
+#
+
+cd "$(dirname "$0")/files" || exit 1
+
+SHELL_BIN=${SHELL_BIN:-./shell}
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+# check name erwartete_ausgabe erwarteter_status befehle
+# fuehrt die befehle mit -c (und den Optionen aus OPTS) aus,
+# Ausgabe "*" wird nicht verglichen
+check() {
+	local out status
+	out=$("$SHELL_BIN" $OPTS -c "$4" 2>&1)
+	status=$?
+	if { [ "$2" == "*" ] || [ "$out" == "$2" ]; } && [ "$status" == "$3" ]; then
+		echo "ok     $1"
+	else
+		echo "FEHLER $1: Ausgabe '$out' Status $status," \
+			"erwartet '$2' Status $3"
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+# -c und source: jede Zeile des Skripts laeuft, danach der Rest der Liste
+printf '/bin/echo eins\necho zwei\n' > "$TMP/s.sh"
+check "source unter -c" "$(printf 'eins\nzwei\nnach')" 0 \
+	"source $TMP/s.sh; /bin/echo nach"
+printf 'echo eins\n/bin/echo zwei\n' > "$TMP/b.sh"
+check "source unter -c (Builtin zuerst)" "$(printf 'eins\nzwei\nnach')" 0 \
+	"source $TMP/b.sh; echo nach"
+
+# -c: Exitstatus ist der Status des letzten Befehls
+check "Status Pipe" "" 1 "false | false"
+check "Status Pipe (letztes Programm)" "" 0 "false | true"
+check "Status externe Pipe" "" 1 "/bin/echo a | /bin/false"
+check "Status Builtin-Pipe" "" 1 "echo a | false"
+check "Status exec" "" 1 "/bin/false"
+check "Status Builtin" "" 1 "true; false"
+check "Status nicht gefunden" "*" 127 "gibtsnicht | true"
+check "Status nach Fehler" "a" 0 "/bin/false; echo a"
+check "Status Hintergrund" "" 0 "/bin/false &"
+check "Status exit" "" 1 "false; exit"
+check "Status time" "*" 3 "time sh -c 'exit 3' >/dev/null"
+printf 'echo eins
+false
+' > "$TMP/f.sh"
+check "Status source" "eins" 1 "source $TMP/f.sh"
+check "Builtin mit zu vielen Argumenten" "*" 2 "cd /tmp weiter; echo a"
+
+# Variablen: ungueltige Namen aendern weder Tabelle noch environ
+check "setenv mit =" "$(printf 'a=b: Invalid argument\n[]')" 0 \
+	"setenv a=b 2; echo [\${a=b}]"
+check "set bleibt lokal" "$(printf '[]\n[x]')" 0 \
+	"set L x; sh -c 'echo [\$L]'; export L; sh -c 'echo [\$L]'"
+
+# Umleitungsfehler: nur diese Stufe scheitert, mit fork() und posix_spawn()
+for OPTS in -p -f; do
+	check "Umleitung fehlt $OPTS" \
+		"$(printf '/nonexist: No such file or directory\nb')" 0 \
+		"cat < /nonexist | /bin/echo b; true"
+	check "Umleitung fehlt, Status $OPTS" \
+		"/nonexist: No such file or directory" 0 "cat < /nonexist | cat"
+	check "Ausgabe fehlt $OPTS" \
+		"$(printf '/nonexist/x: No such file or directory\nc')" 0 \
+		"/bin/echo a > /nonexist/x; /bin/echo c"
+done
+OPTS=
+
+# parallel: {} auch innerhalb von Argumenten
+check "parallel {} im Argument" "$(printf 'x1 1.gz out/1/1\nx22 22.gz out/22/22')" 0 \
+	"parallel -k echo x{} {}.gz out/{}/{} ::: 1 22"
+check "parallel ohne {}" "$(printf 'a 1\na 2')" 0 "parallel -k echo a ::: 1 2"
+
+# "." in $PATH: nach cd wird im neuen Ordner gesucht
+mkdir -p "$TMP/a" "$TMP/b"
+printf '#!/bin/sh\necho A\n' > "$TMP/a/tool"
+printf '#!/bin/sh\necho B\n' > "$TMP/b/tool"
+chmod +x "$TMP/a/tool" "$TMP/b/tool"
+check "PATH mit . und cd" "$(printf 'A\nB')" 0 \
+	"setenv PATH .:/bin:/usr/bin; cd $TMP/a; tool; cd $TMP/b; tool"
+
+echo "$FAILED Fehler"
+[ $FAILED -eq 0 ]